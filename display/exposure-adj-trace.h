@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Tracepoints of the exposure adjustment driver
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM exposure_adj
+
+#if !defined(_EXPOSURE_ADJ_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _EXPOSURE_ADJ_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/* the frames (vblank count) a staged matrix or brightness level is sent and lands in */
+TRACE_EVENT(ea_latch,
+	TP_PROTO(const char *part, u32 value, u64 sent, u64 frame),
+	TP_ARGS(part, value, sent, frame),
+	TP_STRUCT__entry(
+		__string(part, part)
+		__field(u32, value)
+		__field(u64, sent)
+		__field(u64, frame)
+	),
+	TP_fast_assign(
+		__assign_str(part, part);
+		__entry->value = value;
+		__entry->sent = sent;
+		__entry->frame = frame;
+	),
+	TP_printk("%s=%u sent=%llu frame=%llu", __get_str(part), __entry->value,
+		  __entry->sent, __entry->frame)
+);
+
+/* a brightness level requested, and what the panel and matrix get for it */
+TRACE_EVENT(ea_calc_backlight,
+	TP_PROTO(u32 bl_lvl, u32 dbv, u32 coef),
+	TP_ARGS(bl_lvl, dbv, coef),
+	TP_STRUCT__entry(
+		__field(u32, bl_lvl)
+		__field(u32, dbv)
+		__field(u32, coef)
+	),
+	TP_fast_assign(
+		__entry->bl_lvl = bl_lvl;
+		__entry->dbv = dbv;
+		__entry->coef = coef;
+	),
+	TP_printk("bl_lvl=%u dbv=%u coef=%u", __entry->bl_lvl, __entry->dbv,
+		  __entry->coef)
+);
+
+/* a matrix update sent to crtc, along with the brightness it was calculated for */
+TRACE_EVENT(ea_set_matrix,
+	TP_PROTO(u32 coef, u32 bl_lvl, u32 dbv),
+	TP_ARGS(coef, bl_lvl, dbv),
+	TP_STRUCT__entry(
+		__field(u32, coef)
+		__field(u32, bl_lvl)
+		__field(u32, dbv)
+	),
+	TP_fast_assign(
+		__entry->coef = coef;
+		__entry->bl_lvl = bl_lvl;
+		__entry->dbv = dbv;
+	),
+	TP_printk("coef=%u bl_lvl=%u dbv=%u", __entry->coef, __entry->bl_lvl,
+		  __entry->dbv)
+);
+
+#endif /* _EXPOSURE_ADJ_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE exposure-adj-trace
+#include <trace/define_trace.h>
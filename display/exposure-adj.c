@@ -18,33 +18,190 @@
  *
  */
 
-#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/overflow.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <drm/drm_vblank.h>
 
-#include "exynos_drm_decon.h"
 #include "exynos_drm_drv.h"
+#include "panel/panel-samsung-drv.h"
 
 #include "exposure-adj.h"
 
-int linear_matrix_application_threshold = LINEAR_MATRIX_APPLY_THRESHOLD_DEFAULT;
-module_param(linear_matrix_application_threshold, int, 0644);
+#define CREATE_TRACE_POINTS
+#include "exposure-adj-trace.h"
 
-static int ea_set_matrix(struct drm_crtc *crtc, unsigned int bl_lvl)
+/*
+ * Matrix coefficients are quantized to at most EA_COEF_BITS bits before being
+ * used as blob cache keys, so the cache never holds more than
+ * EA_BLOB_CACHE_SIZE blobs no matter how the brightness is swept.
+ */
+#define EA_COEF_BITS		12
+#define EA_COEF_SHIFT							\
+	(ilog2(LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR) > EA_COEF_BITS ?	\
+	 ilog2(LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR) - EA_COEF_BITS : 0)
+#define EA_BLOB_CACHE_SIZE						\
+	((LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR >> EA_COEF_SHIFT) + 1)
+
+static struct drm_property_blob *ea_get_blob(struct exposure_adj *ea,
+					     struct drm_device *dev, __u16 coef)
 {
-	struct exynos_drm_crtc *exynos_crtc = to_exynos_crtc(crtc);
+	/* round to nearest, and keep a dim coefficient from becoming black */
+	const unsigned int key = max_t(unsigned int, DIV_ROUND_CLOSEST(coef, 1 << EA_COEF_SHIFT), 1);
+	struct drm_property_blob *pblob = ea->blobs[key];
 	struct exynos_matrix matrix;
+	__u16 ofs;
+	int i;
+
+	if (pblob) {
+		ea->blob_hits++;
+		return pblob;
+	}
+
+	/*
+	 * Beware: the override itself does not form the final matrix.
+	 * It's ratio that would be applied to linear matrix requested by
+	 * userspace, and we need to set all elements in this matrix.
+	 */
+	ofs = LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR; // = 100% (no scale)
+	matrix.offsets[0] = ofs;
+	matrix.offsets[1] = ofs;
+	matrix.offsets[2] = ofs;
+
+	/* use the dequantized value so that the blob matches its key exactly */
+	coef = key << EA_COEF_SHIFT;
+	for (i = 0; i < ARRAY_SIZE(matrix.coeffs); i++)
+		matrix.coeffs[i] = coef;
+
+	pblob = drm_property_create_blob(dev, sizeof(struct exynos_matrix), &matrix);
+	if (IS_ERR_OR_NULL(pblob))
+		return NULL;
+
+	ea->blobs[key] = pblob;
+	ea->blob_allocs++;
+
+	return pblob;
+}
+
+static void ea_release(void *data)
+{
+	struct exposure_adj *ea = data;
+	int i;
+
+	kfree(ea->cfg);
+	ea->cfg = NULL;
+	for (i = 0; i < EA_BLOB_CACHE_SIZE; i++) {
+		drm_property_blob_put(ea->blobs[i]);
+		ea->blobs[i] = NULL;
+	}
+}
+
+/*
+ * Matrix coefficient bringing the luminance at @threshold down to the one at
+ * @bl_lvl, with luminance following the gamma 2.2 curve of DBV.
+ */
+static u32 ea_calc_gamma_coef(u32 bl_lvl, u32 threshold)
+{
+	const u32 coef = panel_cmn_calc_gamma_2_2_luminance(bl_lvl, threshold,
+							    LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR);
+
+	/* never round down to 0, which would clear the matrix */
+	return max_t(u32, coef, 1);
+}
+
+/*
+ * Build a config from the settings in @set, with everything the brightness path
+ * needs precomputed. This runs at probe and on sysfs writes, which have
+ * validated the settings.
+ */
+static struct ea_config *ea_build_config(const struct ea_config *set)
+{
+	const size_t lut_len = set->curve == EA_CURVE_GAMMA ? set->threshold : 0;
+	struct ea_config *cfg;
+	u32 i;
+
+	cfg = kzalloc(struct_size(cfg, lut, lut_len), GFP_KERNEL);
+	if (!cfg)
+		return NULL;
+
+	cfg->enabled = set->enabled;
+	cfg->curve = set->curve;
+	cfg->threshold = set->threshold;
+	cfg->lp_threshold = set->lp_threshold;
+	cfg->deferred = set->deferred;
+	cfg->recip = div_u64((u64)LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR << 32, set->threshold);
+	for (i = 1; i < lut_len; i++)
+		cfg->lut[i] = ea_calc_gamma_coef(i, set->threshold);
+
+	return cfg;
+}
+
+/* build and publish a new config from the settings in @set, the caller holds cfg_lock */
+static int ea_update_config(struct exposure_adj *ea, const struct ea_config *set)
+{
+	const struct ea_config *old;
+	struct ea_config *cfg;
+
+	cfg = ea_build_config(set);
+	if (!cfg)
+		return -ENOMEM;
+
+	mutex_lock(&ea->lock);
+	old = ea->cfg;
+	ea->cfg = cfg;
+	mutex_unlock(&ea->lock);
+
+	kfree(old);
+
+	return 0;
+}
+
+/* account a matrix update of @coef, which is about to become hw_coef */
+static void ea_update_stats(struct exposure_adj *ea, u32 coef)
+{
+	struct ea_stats *stats = &ea->stats;
+	const ktime_t now = ktime_get();
+
+	if (coef == 0) {
+		stats->clears++;
+	} else {
+		stats->applies++;
+		stats->hist[min_t(u64, (u64)coef * EA_HIST_BUCKETS /
+				  LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR, EA_HIST_BUCKETS - 1)]++;
+	}
+
+	if (stats->active_since && coef == 0) {
+		stats->active_ns += ktime_to_ns(ktime_sub(now, stats->active_since));
+		stats->active_since = 0;
+	} else if (!stats->active_since && coef != 0) {
+		stats->active_since = now;
+	}
+}
+
+/* @coef of 0 clears the matrix */
+static int ea_set_matrix(struct exposure_adj *ea, struct drm_crtc *crtc, u32 coef)
+{
+	struct exynos_drm_crtc *exynos_crtc;
 	struct drm_property *prop_linear_matrix_override;
 	struct drm_property_blob *pblob = NULL;
 	struct exynos_drm_crtc_state fake_crtc_state;
 	uint32_t blob_id;
-	__u16 ofs, coef;
 	int rc = 0;
 
+	if (coef == ea->hw_coef)
+		goto exit;
+
 	if (crtc == NULL) {
 		pr_err("crtc has not been initialized\n");
 		rc = -EIO;
 		goto exit;
 	}
 
+	exynos_crtc = to_exynos_crtc(crtc);
 	prop_linear_matrix_override = exynos_crtc->props.linear_matrix_override;
 	if (prop_linear_matrix_override == NULL) {
 		pr_err("linear matrix overriding is not supported by crtc\n");
@@ -61,35 +218,12 @@ static int ea_set_matrix(struct drm_crtc *crtc, unsigned int bl_lvl)
 		goto exit;
 	}
 
-	if (bl_lvl == 0) {
+	if (coef == 0) {
 		goto setup;
 	}
 
-	/*
-	 * Beware: the override itself does not form the final matrix.
-	 * It's ratio that would be applied to linear matrix requested by
-	 * userspace, and we need to set all elements in this matrix.
-	 */
-	ofs = LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR; // = 100% (no scale)
-	matrix.offsets[0] = ofs;
-	matrix.offsets[1] = ofs;
-	matrix.offsets[2] = ofs;
-
-	coef = bl_lvl * LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR /
-	       linear_matrix_application_threshold;
-	matrix.coeffs[0] = coef;
-	matrix.coeffs[1] = coef;
-	matrix.coeffs[2] = coef;
-	matrix.coeffs[3] = coef;
-	matrix.coeffs[4] = coef;
-	matrix.coeffs[5] = coef;
-	matrix.coeffs[6] = coef;
-	matrix.coeffs[7] = coef;
-	matrix.coeffs[8] = coef;
-
-	pblob = drm_property_create_blob(crtc->dev,
-					 sizeof(struct exynos_matrix), &matrix);
-	if (IS_ERR_OR_NULL(pblob)) {
+	pblob = ea_get_blob(ea, crtc->dev, coef);
+	if (!pblob) {
 		pr_err("failed to create blob\n");
 		rc = -ENOMEM;
 		goto exit;
@@ -106,13 +240,13 @@ setup:
 	 *
 	 * The crtc state here is one time use and thrown away after this call.
 	 * The crtc driver code saves the matrix into a global variable instead
-	 * upon receiving the atomic_set_property call. We need to free the
-	 * resources related to the state ourselves.
+	 * upon receiving the atomic_set_property call. The blob itself stays in
+	 * the cache and is released along with the panel device.
 	 */
 	memset(&fake_crtc_state, 0, sizeof(fake_crtc_state));
 	fake_crtc_state.base.crtc = crtc;
 
-	if (bl_lvl == 0)
+	if (coef == 0)
 		blob_id = 0; // erase matrix
 	else
 		blob_id = pblob->base.id;
@@ -120,25 +254,686 @@ setup:
 	crtc->funcs->atomic_set_property(crtc, &fake_crtc_state.base,
 					 prop_linear_matrix_override, blob_id);
 
-	drm_property_blob_put(pblob);
+	trace_ea_set_matrix(coef, ea->last_bl, ea->last_dbv);
+	ea_update_stats(ea, coef);
+	ea->hw_coef = coef;
 
 exit:
 	return rc;
 }
 
-unsigned int ea_panel_calc_backlight(unsigned int bl_lvl)
+static struct drm_crtc *ea_get_crtc(struct exposure_adj *ea)
 {
-	struct decon_device *decon = get_decon_drvdata(0);
+	const struct drm_connector_state *conn_state = ea->conn->state;
 
-	if (linear_matrix_application_threshold == 0) {
-		linear_matrix_application_threshold = 1; // avoid dividing by 0
+	return conn_state ? conn_state->crtc : NULL;
+}
+
+/* stop the ongoing ramp where it is */
+static void ea_stop_ramp(struct exposure_adj *ea)
+{
+	ea->ramp_step = ea->ramp_len;
+}
+
+/* coefficient at the current ramp step, interpolated with 0 taken as no dimming */
+static u32 ea_ramp_coef(const struct exposure_adj *ea)
+{
+	const s64 from = ea->ramp_from ?: LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR;
+	const s64 to = ea->ramp_to ?: LINEAR_MATRIX_OVERRIDE_SCALE_FACTOR;
+
+	if (ea->ramp_step >= ea->ramp_len)
+		return ea->ramp_to;
+
+	return from + div_s64((to - from) * ea->ramp_step, ea->ramp_len);
+}
+
+/* set the matrix of the next ramp step, if a ramp is ongoing */
+static void ea_ramp_step(struct exposure_adj *ea)
+{
+	if (ea->ramp_step >= ea->ramp_len)
+		return;
+
+	ea->ramp_step++;
+	ea_set_matrix(ea, ea_get_crtc(ea), ea_ramp_coef(ea));
+}
+
+/*
+ * Move the matrix to @coef over ramp_frames frames, one property update per
+ * frame commit: the first step is set right away to land along with the new
+ * brightness level, and the following ones by ea_panel_commit_done(). A new
+ * target replaces the ongoing ramp, starting from wherever it has got to.
+ */
+static void ea_update_matrix(struct exposure_adj *ea, u32 coef, bool ramp)
+{
+	if (!ramp || ea->ramp_frames <= 1 || ea->hw_coef == EA_COEF_INVALID) {
+		ea_stop_ramp(ea);
+		ea_set_matrix(ea, ea_get_crtc(ea), coef);
+		return;
 	}
 
-	if (bl_lvl != 0 && bl_lvl < linear_matrix_application_threshold) {
-		ea_set_matrix(&decon->crtc->base, bl_lvl);
-		return linear_matrix_application_threshold;
+	if (ea->ramp_step < ea->ramp_len && ea->ramp_to == coef)
+		return;
+
+	if (ea->hw_coef == coef) {
+		ea_stop_ramp(ea);
+		return;
+	}
+
+	ea->ramp_from = ea->hw_coef;
+	ea->ramp_to = coef;
+	ea->ramp_len = ea->ramp_frames;
+	ea->ramp_step = 0;
+	ea_ramp_step(ea);
+}
+
+static const char * const ea_curve_names[EA_CURVE_MAX] = {
+	[EA_CURVE_LINEAR] = "linear",
+	[EA_CURVE_GAMMA] = "gamma",
+};
+
+#define to_ea(attr) ((struct exposure_adj *)container_of(attr, struct dev_ext_attribute, attr)->var)
+
+static ssize_t enable_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	bool enabled;
+
+	mutex_lock(&ea->cfg_lock);
+	enabled = ea->cfg->enabled;
+	mutex_unlock(&ea->cfg_lock);
+
+	return sysfs_emit(buf, "%d\n", enabled);
+}
+
+static ssize_t enable_store(struct device *dev, struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	struct ea_config set;
+	bool enabled;
+	int ret;
+
+	ret = kstrtobool(buf, &enabled);
+	if (ret)
+		return ret;
+
+	mutex_lock(&ea->cfg_lock);
+	set = *ea->cfg;
+	set.enabled = enabled;
+	ret = ea_update_config(ea, &set);
+	mutex_unlock(&ea->cfg_lock);
+
+	return ret ? : count;
+}
+
+static ssize_t curve_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	enum ea_curve curve;
+
+	mutex_lock(&ea->cfg_lock);
+	curve = ea->cfg->curve;
+	mutex_unlock(&ea->cfg_lock);
+
+	return sysfs_emit(buf, "%s\n", ea_curve_names[curve]);
+}
+
+static ssize_t curve_store(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	struct ea_config set;
+	int curve, ret;
+
+	curve = sysfs_match_string(ea_curve_names, buf);
+	if (curve < 0)
+		return curve;
+
+	mutex_lock(&ea->cfg_lock);
+	set = *ea->cfg;
+	set.curve = curve;
+	ret = ea_update_config(ea, &set);
+	mutex_unlock(&ea->cfg_lock);
+
+	return ret ? : count;
+}
+
+static ssize_t threshold_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	u32 threshold;
+
+	mutex_lock(&ea->cfg_lock);
+	threshold = ea->cfg->threshold;
+	mutex_unlock(&ea->cfg_lock);
+
+	return sysfs_emit(buf, "%u\n", threshold);
+}
+
+static ssize_t threshold_store(struct device *dev, struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	struct ea_config set;
+	u32 threshold;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &threshold);
+	if (ret)
+		return ret;
+
+	if (threshold == 0 || threshold > ea->max_threshold)
+		return -EINVAL;
+
+	mutex_lock(&ea->cfg_lock);
+	set = *ea->cfg;
+	set.threshold = threshold;
+	ret = ea_update_config(ea, &set);
+	mutex_unlock(&ea->cfg_lock);
+
+	return ret ? : count;
+}
+
+static ssize_t lp_threshold_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	u32 lp_threshold;
+
+	mutex_lock(&ea->cfg_lock);
+	lp_threshold = ea->cfg->lp_threshold;
+	mutex_unlock(&ea->cfg_lock);
+
+	return sysfs_emit(buf, "%u\n", lp_threshold);
+}
+
+/* 0 turns AOD dimming off */
+static ssize_t lp_threshold_store(struct device *dev, struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	struct ea_config set;
+	u32 lp_threshold;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &lp_threshold);
+	if (ret)
+		return ret;
+
+	if (lp_threshold > ea->max_threshold)
+		return -EINVAL;
+
+	mutex_lock(&ea->cfg_lock);
+	set = *ea->cfg;
+	set.lp_threshold = lp_threshold;
+	ret = ea_update_config(ea, &set);
+	mutex_unlock(&ea->cfg_lock);
+
+	return ret ? : count;
+}
+
+static ssize_t deferred_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	bool deferred;
+
+	mutex_lock(&ea->cfg_lock);
+	deferred = ea->cfg->deferred;
+	mutex_unlock(&ea->cfg_lock);
+
+	return sysfs_emit(buf, "%d\n", deferred);
+}
+
+static ssize_t deferred_store(struct device *dev, struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct exposure_adj *ea = to_ea(attr);
+	struct ea_config set;
+	bool deferred;
+	int ret;
+
+	ret = kstrtobool(buf, &deferred);
+	if (ret)
+		return ret;
+
+	mutex_lock(&ea->cfg_lock);
+	set = *ea->cfg;
+	set.deferred = deferred;
+	ret = ea_update_config(ea, &set);
+	mutex_unlock(&ea->cfg_lock);
+
+	return ret ? : count;
+}
+
+static const struct device_attribute ea_attrs[] = {
+	__ATTR_RW(enable),
+	__ATTR_RW(curve),
+	__ATTR_RW(threshold),
+	__ATTR_RW(lp_threshold),
+	__ATTR_RW(deferred),
+};
+
+/**
+ * struct ea_sysfs - sysfs attributes of an exposure adjustment instance
+ *
+ * The attributes are created per instance, each carrying the instance in
+ * &dev_ext_attribute.var, so that panel drivers don't need to provide any
+ * glue of their own.
+ */
+struct ea_sysfs {
+	/** @ext_attrs: attributes pointing back to the instance */
+	struct dev_ext_attribute ext_attrs[ARRAY_SIZE(ea_attrs)];
+	/** @attrs: NULL terminated attribute list of @group */
+	struct attribute *attrs[ARRAY_SIZE(ea_attrs) + 1];
+	/** @group: the exposure_adj group under the panel device */
+	struct attribute_group group;
+};
+
+static int ea_sysfs_init(struct exposure_adj *ea, struct device *dev)
+{
+	struct ea_sysfs *sysfs;
+	int i;
+
+	sysfs = devm_kzalloc(dev, sizeof(*sysfs), GFP_KERNEL);
+	if (!sysfs)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(ea_attrs); i++) {
+		sysfs->ext_attrs[i].attr = ea_attrs[i];
+		sysfs->ext_attrs[i].var = ea;
+		sysfs_attr_init(&sysfs->ext_attrs[i].attr.attr);
+		sysfs->attrs[i] = &sysfs->ext_attrs[i].attr.attr;
+	}
+	sysfs->group.name = "exposure_adj";
+	sysfs->group.attrs = sysfs->attrs;
+
+	return devm_device_add_group(dev, &sysfs->group);
+}
+
+/**
+ * ea_init - initialize exposure adjustment state of a display
+ * @ea: exposure adjustment state, normally embedded in the panel struct
+ * @dev: the panel device, which gets the exposure_adj sysfs group and whose
+ *       unbinding releases everything
+ * @conn: connector of the panel, the matrix is applied to the crtc driving it
+ * @cap: brightness capability of the panel, whose normal range bounds the
+ *       threshold
+ *
+ * The sysfs group goes on the panel device rather than the connector kdev:
+ * this runs at panel probe, before the connector is registered by the display
+ * driver, which offers no hook to add attributes later. A panel drives a
+ * single connector, and the framework keeps the other per-panel attributes on
+ * the panel device as well.
+ *
+ * Return: 0 on success, negative errno otherwise.
+ */
+int ea_init(struct exposure_adj *ea, struct device *dev, struct drm_connector *conn,
+	    const struct brightness_capability *cap)
+{
+	struct ea_config set = {
+		.enabled = true,
+		.curve = EA_CURVE_GAMMA,
+	};
+	int ret;
+
+	mutex_init(&ea->lock);
+	mutex_init(&ea->cfg_lock);
+	ea->conn = conn;
+
+	ea->blobs = devm_kcalloc(dev, EA_BLOB_CACHE_SIZE, sizeof(*ea->blobs), GFP_KERNEL);
+	if (!ea->blobs)
+		return -ENOMEM;
+
+	ea->max_threshold = max_t(u32, cap->normal.level.max, 1);
+	set.threshold = min_t(u32, LINEAR_MATRIX_APPLY_THRESHOLD_DEFAULT, ea->max_threshold);
+	ea->cfg = ea_build_config(&set);
+	if (!ea->cfg)
+		return -ENOMEM;
+
+	ea_reset(ea);
+
+	ret = devm_add_action_or_reset(dev, ea_release, ea);
+	if (ret)
+		return ret;
+
+	return ea_sysfs_init(ea, dev);
+}
+
+/**
+ * ea_reset - forget the matrix state known to be applied
+ * @ea: exposure adjustment state
+ *
+ * Called when the applied state can no longer be trusted, e.g. after panel
+ * reset. The next update is then sent to crtc unconditionally, and anything
+ * staged or frozen is dropped.
+ */
+void ea_reset(struct exposure_adj *ea)
+{
+	mutex_lock(&ea->lock);
+	ea_stop_ramp(ea);
+	ea->hw_coef = EA_COEF_INVALID;
+	ea->staged = false;
+	ea->frozen = false;
+	memset(ea->latch, 0, sizeof(ea->latch));
+	mutex_unlock(&ea->lock);
+}
+
+/**
+ * ea_set_ramp_frames - set the number of frames matrix changes are spread over
+ * @ea: exposure adjustment state
+ * @frames: frames the panel takes to dim to a new brightness level, 0 or 1 to
+ *          apply matrix changes at once
+ *
+ * Takes effect from the next brightness update. Turning the matrix off and
+ * deferred updates are never ramped.
+ */
+void ea_set_ramp_frames(struct exposure_adj *ea, u32 frames)
+{
+	mutex_lock(&ea->lock);
+	ea->ramp_frames = frames;
+	mutex_unlock(&ea->lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int ea_stats_show(struct seq_file *m, void *data)
+{
+	struct exposure_adj *ea = m->private;
+	const struct ea_stats *stats = &ea->stats;
+	u64 active_ns;
+	int i;
+
+	mutex_lock(&ea->lock);
+	active_ns = stats->active_ns;
+	if (stats->active_since)
+		active_ns += ktime_to_ns(ktime_sub(ktime_get(), stats->active_since));
+
+	seq_printf(m, "applies: %llu\n", stats->applies);
+	seq_printf(m, "clears: %llu\n", stats->clears);
+	seq_printf(m, "blob_allocs: %llu\n", ea->blob_allocs);
+	seq_printf(m, "blob_hits: %llu\n", ea->blob_hits);
+	seq_printf(m, "active_ms: %llu\n", div_u64(active_ns, NSEC_PER_MSEC));
+	seq_puts(m, "coef_hist:");
+	for (i = 0; i < EA_HIST_BUCKETS; i++)
+		seq_printf(m, " %llu", stats->hist[i]);
+	seq_putc(m, '\n');
+	mutex_unlock(&ea->lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ea_stats);
+
+void ea_debugfs_init(struct exposure_adj *ea, struct dentry *parent)
+{
+	struct dentry *root = debugfs_create_dir("exposure_adj", parent);
+
+	debugfs_create_file("stats", 0444, root, ea, &ea_stats_fops);
+	debugfs_create_u32("hw_coef", 0444, root, &ea->hw_coef);
+}
+#endif
+
+/* everything is precomputed in cfg, so this is a lookup or a multiplication */
+static u32 ea_calc_coef(struct exposure_adj *ea, unsigned int bl_lvl, u32 *coef)
+{
+	const struct ea_config *cfg = ea->cfg;
+	u32 dbv;
+
+	if (!cfg->enabled || bl_lvl == 0 || bl_lvl >= cfg->threshold) {
+		*coef = 0;
+		dbv = bl_lvl;
+	} else {
+		if (cfg->curve == EA_CURVE_GAMMA)
+			*coef = cfg->lut[bl_lvl];
+		else
+			/* never round down to 0, which would clear the matrix */
+			*coef = max_t(u32, (bl_lvl * cfg->recip) >> 32, 1);
+		dbv = cfg->threshold;
+	}
+
+	ea->last_bl = bl_lvl;
+	ea->last_dbv = dbv;
+	trace_ea_calc_backlight(bl_lvl, dbv, *coef);
+
+	return dbv;
+}
+
+static u32 ea_calc_backlight_locked(struct exposure_adj *ea, unsigned int bl_lvl)
+{
+	u32 coef, dbv;
+
+	ea->staged = false;
+	dbv = ea_calc_coef(ea, bl_lvl, &coef);
+	ea_update_matrix(ea, coef, bl_lvl != 0);
+
+	return dbv;
+}
+
+/**
+ * ea_panel_calc_backlight - apply exposure adjustment for a brightness level
+ * @ea: exposure adjustment state
+ * @bl_lvl: requested brightness level, 0 to turn the matrix off
+ *
+ * The crtc property is only touched when the resulting coefficient differs
+ * from the one applied last time, so updates in the normal brightness range
+ * do no DPP work once the matrix is cleared. Anything staged by
+ * ea_panel_stage_backlight() is dropped. If ramp frames are set, the matrix
+ * is moved to the new coefficient across them, except when turned off.
+ * This applies even while frozen by ea_freeze().
+ *
+ * Return: the brightness level to be sent to panel.
+ */
+unsigned int ea_panel_calc_backlight(struct exposure_adj *ea, unsigned int bl_lvl)
+{
+	u32 dbv;
+
+	mutex_lock(&ea->lock);
+	dbv = ea_calc_backlight_locked(ea, bl_lvl);
+	mutex_unlock(&ea->lock);
+
+	return dbv;
+}
+
+/**
+ * ea_panel_calc_lp_backlight - apply exposure adjustment in LP mode
+ * @ea: exposure adjustment state
+ * @bl_lvl: requested brightness level
+ *
+ * When lp_threshold of the config is set, AOD brightness lower than it keeps
+ * the panel at the AOD mode of lp_threshold and dims the frame with the matrix instead,
+ * which gives a continuous range of dim AOD levels without extra panel modes.
+ * The coefficient is calculated on the spot since AOD brightness rarely
+ * changes.
+ *
+ * Return: the brightness level to pick the binned LP mode with.
+ */
+u32 ea_panel_calc_lp_backlight(struct exposure_adj *ea, unsigned int bl_lvl)
+{
+	const struct ea_config *cfg;
+	u32 coef = 0;
+
+	mutex_lock(&ea->lock);
+	cfg = ea->cfg;
+	ea->staged = false;
+	ea->last_bl = bl_lvl;
+	if (cfg->enabled && bl_lvl != 0 && bl_lvl < cfg->lp_threshold) {
+		coef = ea_calc_gamma_coef(bl_lvl, cfg->lp_threshold);
+		bl_lvl = cfg->lp_threshold;
+	}
+	ea->last_dbv = bl_lvl;
+	ea_update_matrix(ea, coef, false);
+	mutex_unlock(&ea->lock);
+
+	return bl_lvl;
+}
+
+/**
+ * ea_panel_stage_backlight - stage exposure adjustment for the next commit
+ * @ea: exposure adjustment state
+ * @bl_lvl: requested brightness level
+ * @dbv: returns the brightness level to be sent to panel
+ *
+ * If the config is deferred, a brightness update which changes the matrix is
+ * staged instead of being applied, so that the panel driver can send the
+ * matrix and the brightness level in the same frame through
+ * ea_panel_commit_staged(). Otherwise this behaves as ea_panel_calc_backlight().
+ *
+ * While frozen by ea_freeze(), an update which changes the matrix is held back
+ * altogether, and the caller is expected to apply its latest brightness again
+ * once ea_thaw() tells so.
+ *
+ * Return: true if the update is staged or held back and @dbv must not be
+ * sent yet.
+ */
+bool ea_panel_stage_backlight(struct exposure_adj *ea, unsigned int bl_lvl, u32 *dbv)
+{
+	u32 coef;
+	bool staged;
+
+	mutex_lock(&ea->lock);
+	if (ea->frozen) {
+		*dbv = ea_calc_coef(ea, bl_lvl, &coef);
+		staged = coef != ea->hw_coef;
+		ea->thaw_pending |= staged;
+	} else if (!ea->cfg->deferred) {
+		*dbv = ea_calc_backlight_locked(ea, bl_lvl);
+		staged = false;
 	} else {
-		ea_set_matrix(&decon->crtc->base, 0);
-		return bl_lvl;
+		/* the staged matrix lands in one frame along with dbv */
+		ea_stop_ramp(ea);
+		*dbv = ea_calc_coef(ea, bl_lvl, &coef);
+		staged = coef != ea->hw_coef;
+		ea->staged = staged;
+		if (staged) {
+			ea->staged_coef = coef;
+			ea->staged_dbv = *dbv;
+		}
+	}
+	mutex_unlock(&ea->lock);
+
+	return staged;
+}
+
+/* remember @value of @part just sent, to trace it at the frame it lands in */
+static void ea_note_latch(struct exposure_adj *ea, enum ea_latch_part part, u32 value)
+{
+	struct drm_crtc *crtc = ea_get_crtc(ea);
+	struct ea_latch *latch = &ea->latch[part];
+
+	if (!trace_ea_latch_enabled() || !crtc)
+		return;
+
+	latch->pending = true;
+	latch->value = value;
+	latch->sent = drm_crtc_vblank_count(crtc);
+}
+
+/**
+ * ea_freeze - hold back matrix changes during a latency critical sequence
+ * @ea: exposure adjustment state
+ *
+ * Until ea_thaw(), brightness updates through ea_panel_stage_backlight() do
+ * no crtc property or blob work. The ongoing ramp stops where it is and
+ * anything staged is dropped, both to be redone after thawing.
+ */
+void ea_freeze(struct exposure_adj *ea)
+{
+	mutex_lock(&ea->lock);
+	if (!ea->frozen) {
+		ea->frozen = true;
+		ea->thaw_pending = ea->staged || ea->ramp_step < ea->ramp_len;
+		ea->staged = false;
+		ea_stop_ramp(ea);
+	}
+	mutex_unlock(&ea->lock);
+}
+
+/**
+ * ea_thaw - let matrix changes through again
+ * @ea: exposure adjustment state
+ *
+ * Return: true if any update was held back while frozen, in which case the
+ * caller should apply its latest brightness again.
+ */
+bool ea_thaw(struct exposure_adj *ea)
+{
+	bool pending;
+
+	mutex_lock(&ea->lock);
+	pending = ea->frozen && ea->thaw_pending;
+	ea->frozen = false;
+	ea->thaw_pending = false;
+	mutex_unlock(&ea->lock);
+
+	return pending;
+}
+
+/**
+ * ea_panel_commit_staged - apply the staged matrix
+ * @ea: exposure adjustment state
+ * @dbv: returns the staged brightness level, which the caller must send to
+ *       panel right away so that both latch at the same TE
+ *
+ * Return: true if there was a staged update.
+ */
+bool ea_panel_commit_staged(struct exposure_adj *ea, u32 *dbv)
+{
+	bool staged;
+
+	mutex_lock(&ea->lock);
+	staged = ea->staged;
+	if (staged) {
+		ea->staged = false;
+		ea_set_matrix(ea, ea_get_crtc(ea), ea->staged_coef);
+		ea_note_latch(ea, EA_LATCH_MATRIX, ea->staged_coef);
+		*dbv = ea->staged_dbv;
+	}
+	mutex_unlock(&ea->lock);
+
+	return staged;
+}
+
+/**
+ * ea_trace_dbv_latch - record the brightness level sent along with a staged matrix
+ * @ea: exposure adjustment state
+ * @dbv: brightness level sent to panel
+ *
+ * It is traced with the frame it lands in by ea_panel_commit_done().
+ */
+void ea_trace_dbv_latch(struct exposure_adj *ea, u32 dbv)
+{
+	mutex_lock(&ea->lock);
+	ea_note_latch(ea, EA_LATCH_DBV, dbv);
+	mutex_unlock(&ea->lock);
+}
+
+static const char * const ea_latch_names[EA_LATCH_MAX] = {
+	[EA_LATCH_MATRIX] = "matrix",
+	[EA_LATCH_DBV] = "dbv",
+};
+
+/**
+ * ea_panel_commit_done - a frame update of the panel is done
+ * @ea: exposure adjustment state
+ *
+ * To be called by the panel driver once per frame commit, before sending
+ * anything new. Updates sent since the previous call land in this frame, and
+ * the ongoing ramp advances by one step.
+ */
+void ea_panel_commit_done(struct exposure_adj *ea)
+{
+	struct drm_crtc *crtc;
+	int i;
+
+	mutex_lock(&ea->lock);
+	crtc = ea_get_crtc(ea);
+	for (i = 0; i < EA_LATCH_MAX; i++) {
+		struct ea_latch *latch = &ea->latch[i];
+
+		if (!latch->pending)
+			continue;
+		latch->pending = false;
+		if (crtc)
+			trace_ea_latch(ea_latch_names[i], latch->value, latch->sent,
+				       drm_crtc_vblank_count(crtc));
 	}
+	ea_ramp_step(ea);
+	mutex_unlock(&ea->lock);
 }
@@ -21,6 +21,9 @@
 #ifndef EXPOSURE_ADJUSTMENT_H
 #define EXPOSURE_ADJUSTMENT_H
 
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+
 /**
  * When linear matrix is enabled, brightness lower than this will not be sent
  * to panel. The panel driver IC gets this value instead, and DPP is engaged to
@@ -30,6 +33,168 @@
  */
 #define LINEAR_MATRIX_APPLY_THRESHOLD_DEFAULT        1400
 
-u32 ea_panel_calc_backlight(unsigned int bl_lvl);
+#define EA_COEF_INVALID	U32_MAX
+
+#define EA_HIST_BUCKETS	16
+
+struct brightness_capability;
+struct dentry;
+struct device;
+struct drm_connector;
+struct drm_property_blob;
+
+/**
+ * enum ea_curve - how the matrix coefficient follows brightness below threshold
+ * @EA_CURVE_LINEAR: proportional to brightness level
+ * @EA_CURVE_GAMMA: follows the gamma 2.2 luminance of brightness level
+ * @EA_CURVE_MAX: placeholder, counter for number of curves
+ */
+enum ea_curve {
+	EA_CURVE_LINEAR = 0,
+	EA_CURVE_GAMMA,
+	EA_CURVE_MAX,
+};
+
+/**
+ * enum ea_latch_part - parts of a staged update traced at the frame they land in
+ * @EA_LATCH_MATRIX: the linear matrix
+ * @EA_LATCH_DBV: the brightness level sent to panel
+ * @EA_LATCH_MAX: placeholder, counter for number of parts
+ */
+enum ea_latch_part {
+	EA_LATCH_MATRIX = 0,
+	EA_LATCH_DBV,
+	EA_LATCH_MAX,
+};
+
+/**
+ * struct ea_latch - a sent update waiting to be traced
+ * @pending: sent and not traced yet
+ * @value: the coefficient or brightness level sent
+ * @sent: frame (vblank count) it is sent in
+ */
+struct ea_latch {
+	bool pending;
+	u32 value;
+	u64 sent;
+};
+
+/**
+ * struct ea_config - exposure adjustment settings of a display
+ *
+ * A config is validated and built as a whole when written through sysfs, and
+ * then published by swapping the pointer held in &struct exposure_adj, so the
+ * brightness path only does a lookup or a multiplication.
+ */
+struct ea_config {
+	/** @enabled: whether the matrix is used at all */
+	bool enabled;
+	/** @curve: how the coefficient follows brightness below @threshold */
+	enum ea_curve curve;
+	/** @threshold: brightness lower than this is dimmed by the matrix, never 0 */
+	u32 threshold;
+	/** @lp_threshold: AOD brightness lower than this is dimmed by the matrix, 0 to disable */
+	u32 lp_threshold;
+	/** @deferred: stage matrix and brightness level changes to land in the same frame */
+	bool deferred;
+	/** @recip: full scale coefficient divided by @threshold in Q32 */
+	u64 recip;
+	/** @lut: coefficient of each brightness level below @threshold, gamma curve only */
+	u16 lut[];
+};
+
+/**
+ * struct ea_stats - matrix usage of a display
+ *
+ * Gives an idea of how much DPP work the linear matrix costs in the field, to
+ * be correlated with power at dim brightness.
+ */
+struct ea_stats {
+	/** @applies: number of times a dimming matrix is sent to crtc */
+	u64 applies;
+	/** @clears: number of times the matrix is cleared */
+	u64 clears;
+	/** @active_ns: time spent with a dimming matrix, up to @active_since */
+	u64 active_ns;
+	/** @active_since: when the current dimming matrix was set, 0 if none */
+	ktime_t active_since;
+	/** @hist: matrix applies by coefficient, in equal fractions of full scale */
+	u64 hist[EA_HIST_BUCKETS];
+};
+
+/**
+ * struct exposure_adj - exposure adjustment state of a display
+ *
+ * Each panel driver making use of exposure adjustment embeds one of these and
+ * initializes it with ea_init(). The instance is bound to the panel connector,
+ * and applies the matrix to whichever crtc drives that connector.
+ */
+struct exposure_adj {
+	/** @lock: protects the matrix state */
+	struct mutex lock;
+	/** @conn: connector of the panel */
+	struct drm_connector *conn;
+	/** @cfg: settings in effect, replaced as a whole under @lock */
+	const struct ea_config *cfg;
+	/** @cfg_lock: serializes building and replacing @cfg */
+	struct mutex cfg_lock;
+	/** @max_threshold: highest threshold allowed, the top of the normal range */
+	u32 max_threshold;
+	/** @hw_coef: coefficient applied to crtc, 0 if cleared, EA_COEF_INVALID if unknown */
+	u32 hw_coef;
+	/** @blobs: linear matrix blobs indexed by quantized coefficient */
+	struct drm_property_blob **blobs;
+	/** @blob_allocs: number of blobs created */
+	u64 blob_allocs;
+	/** @blob_hits: number of matrix updates served from the blob cache */
+	u64 blob_hits;
+	/** @stats: matrix usage statistics */
+	struct ea_stats stats;
+	/** @last_bl: brightness level of the last calculation, for tracing */
+	u32 last_bl;
+	/** @last_dbv: brightness level sent to panel for @last_bl, for tracing */
+	u32 last_dbv;
+	/** @staged: a matrix and brightness update is staged for the next commit */
+	bool staged;
+	/** @staged_coef: the staged coefficient */
+	u32 staged_coef;
+	/** @staged_dbv: the staged brightness level to be sent to panel */
+	u32 staged_dbv;
+	/** @latch: sent updates to be traced by ea_panel_commit_done(), tracing only */
+	struct ea_latch latch[EA_LATCH_MAX];
+	/** @ramp_frames: frames a matrix change is spread over, 0 or 1 to apply at once */
+	u32 ramp_frames;
+	/** @ramp_from: coefficient the ongoing ramp starts from */
+	u32 ramp_from;
+	/** @ramp_to: coefficient the ongoing ramp ends at */
+	u32 ramp_to;
+	/** @ramp_len: number of frames of the ongoing ramp */
+	u32 ramp_len;
+	/** @ramp_step: frames done in the ongoing ramp, equal to @ramp_len when idle */
+	u32 ramp_step;
+	/** @frozen: matrix changes are held back, see ea_freeze() */
+	bool frozen;
+	/** @thaw_pending: a matrix change was held back while @frozen */
+	bool thaw_pending;
+};
+
+int ea_init(struct exposure_adj *ea, struct device *dev, struct drm_connector *conn,
+	    const struct brightness_capability *cap);
+void ea_reset(struct exposure_adj *ea);
+void ea_set_ramp_frames(struct exposure_adj *ea, u32 frames);
+u32 ea_panel_calc_backlight(struct exposure_adj *ea, unsigned int bl_lvl);
+u32 ea_panel_calc_lp_backlight(struct exposure_adj *ea, unsigned int bl_lvl);
+bool ea_panel_stage_backlight(struct exposure_adj *ea, unsigned int bl_lvl, u32 *dbv);
+bool ea_panel_commit_staged(struct exposure_adj *ea, u32 *dbv);
+void ea_freeze(struct exposure_adj *ea);
+bool ea_thaw(struct exposure_adj *ea);
+void ea_trace_dbv_latch(struct exposure_adj *ea, u32 dbv);
+void ea_panel_commit_done(struct exposure_adj *ea);
+
+#ifdef CONFIG_DEBUG_FS
+void ea_debugfs_init(struct exposure_adj *ea, struct dentry *parent);
+#else
+static inline void ea_debugfs_init(struct exposure_adj *ea, struct dentry *parent) { }
+#endif
 
 #endif /* EXPOSURE_ADJUSTMENT_H */
@@ -0,0 +1,395 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * KUnit tests of the hk3 panel feature command tables.
+ *
+ * Copyright (c) 2022 Google LLC
+ *
+ * Every prebuilt entry is compared with what the branch based hk3_set_panel_feat() used
+ * to send for the same inputs, written out again below in its original form.
+ */
+
+#include <kunit/test.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+#include "hk3-feat.h"
+
+/* TE setting the way hk3_set_panel_feat() built it */
+static void hk3_ref_te(struct hk3_cmd_seq *seq, bool fixed, bool ns)
+{
+	u8 val;
+
+	if (fixed) {
+		/* Fixed TE */
+		HK3_SEQ_ADD(seq, 0xB9, 0x51);
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x02, 0xB9);
+		val = ns ? 0x01 : 0x00;
+		HK3_SEQ_ADD(seq, 0xB9, val);
+		/* Fixed TE width setting */
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x08, 0xB9);
+		if (ns) {
+			HK3_SEQ_ADD(seq, 0xB9, 0x0B, 0x43, 0x00, 0x2F,
+				0x0B, 0x43, 0x00, 0x2F);
+		} else {
+			HK3_SEQ_ADD(seq, 0xB9, 0x0B, 0xBB, 0x00, 0x2F,
+				0x0B, 0xBB, 0x00, 0x2F);
+		}
+	} else {
+		/* Changeable TE */
+		HK3_SEQ_ADD(seq, 0xB9, 0x04);
+		/* Changeable TE width setting and frequency */
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x04, 0xB9);
+		if (ns)
+			HK3_SEQ_ADD(seq, 0xB9, 0x0B, 0x43, 0x00, 0x2F);
+		else
+			HK3_SEQ_ADD(seq, 0xB9, 0x0B, 0xBB, 0x00, 0x2F);
+	}
+}
+
+/* IRC setting by @irc, with FEAT_IRC_OFF or FEAT_IRC_Z_MODE at @set */
+static void hk3_ref_irc(struct hk3_cmd_seq *seq, enum hk3_irc irc, bool set)
+{
+	u8 val;
+
+	if (irc == HK3_IRC_PROTO) {
+		HK3_SEQ_ADD(seq, 0xB0, 0x01, 0x9B, 0x92);
+		val = set ? 0x07 : 0x27;
+		HK3_SEQ_ADD(seq, 0x92, val);
+		return;
+	}
+
+	HK3_SEQ_ADD(seq, 0xB0, 0x02, 0x00, 0x92);
+	if (set) {
+		if (irc == HK3_IRC_FLAT_E6) {
+			HK3_SEQ_ADD(seq, 0x92, 0xBE, 0x98);
+			HK3_SEQ_ADD(seq, 0xB0, 0x02, 0xF3, 0x68);
+			HK3_SEQ_ADD(seq, 0x68, 0x97, 0x87, 0x87, 0xFB, 0xFD, 0xF1);
+		} else {
+			HK3_SEQ_ADD(seq, 0x92, 0xF1, 0xC1);
+			HK3_SEQ_ADD(seq, 0xB0, 0x02, 0xF3, 0x68);
+			HK3_SEQ_ADD(seq, 0x68, 0x82, 0x70, 0x23, 0x91, 0x88, 0x3C);
+		}
+	} else {
+		HK3_SEQ_ADD(seq, 0x92, 0x00, 0x00);
+		HK3_SEQ_ADD(seq, 0xB0, 0x02, 0xF3, 0x68);
+		if (irc == HK3_IRC_FLAT_E6)
+			HK3_SEQ_ADD(seq, 0x68, 0x71, 0x81, 0x59, 0x90, 0xA2, 0x80);
+		else
+			HK3_SEQ_ADD(seq, 0x68, 0x77, 0x81, 0x23, 0x8C, 0x99, 0x3C);
+	}
+}
+
+static void hk3_ref_op(struct hk3_cmd_seq *seq, bool ns)
+{
+	/* mode set */
+	HK3_SEQ_ADD(seq, 0xF2, 0x01);
+	HK3_SEQ_ADD(seq, 0x60, ns ? 0x18 : 0x00);
+}
+
+static void hk3_ref_early_exit(struct hk3_cmd_seq *seq, bool early_exit, bool ns, bool hbm)
+{
+	u8 val;
+
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x10, 0xBD);
+	val = early_exit ? 0x22 : 0x00;
+	HK3_SEQ_ADD(seq, 0xBD, val);
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x82, 0xBD);
+	HK3_SEQ_ADD(seq, 0xBD, val, val, val, val);
+	val = ns ? 0x4E : 0x1E;
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, val, 0xBD);
+	if (hbm) {
+		if (ns)
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00, 0x02,
+				0x00, 0x04, 0x00, 0x0A, 0x00, 0x16, 0x00, 0x76);
+		else
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00, 0x01,
+				0x00, 0x03, 0x00, 0x0B, 0x00, 0x17, 0x00, 0x77);
+	} else {
+		if (ns)
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00, 0x04,
+				0x00, 0x08, 0x00, 0x14, 0x00, 0x2C, 0x00, 0xEC);
+		else
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00, 0x02,
+				0x00, 0x06, 0x00, 0x16, 0x00, 0x2E, 0x00, 0xEE);
+	}
+}
+
+static void hk3_ref_frame_auto(struct hk3_cmd_seq *seq, bool ns, bool hbm, u32 vrefresh,
+			       u32 idle_vrefresh)
+{
+	u8 val;
+
+	if (ns) {
+		/* threshold setting */
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x0C, 0xBD);
+		HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00);
+	} else {
+		/* initial frequency */
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x92, 0xBD);
+		if (vrefresh == 60)
+			val = hbm ? 0x01 : 0x02;
+		else /* 120Hz */
+			val = 0x00;
+		HK3_SEQ_ADD(seq, 0xBD, 0x00, val);
+	}
+	/* target frequency */
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x12, 0xBD);
+	if (ns) {
+		if (idle_vrefresh == 30)
+			val = hbm ? 0x02 : 0x04;
+		else if (idle_vrefresh == 10)
+			val = hbm ? 0x0A : 0x14;
+		else /* 1Hz */
+			val = hbm ? 0x76 : 0xEC;
+	} else {
+		if (idle_vrefresh == 30)
+			val = hbm ? 0x03 : 0x06;
+		else if (idle_vrefresh == 10)
+			val = hbm ? 0x0B : 0x16;
+		else /* 1Hz */
+			val = hbm ? 0x77 : 0xEE;
+	}
+	HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, val);
+	/* step setting */
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x9E, 0xBD);
+	if (ns) {
+		if (hbm)
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x02, 0x00, 0x0A, 0x00, 0x00);
+		else
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x04, 0x00, 0x14, 0x00, 0x00);
+	} else {
+		if (hbm)
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x01, 0x00, 0x03, 0x00, 0x0B);
+		else
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x02, 0x00, 0x06, 0x00, 0x16);
+	}
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0xAE, 0xBD);
+	if (ns) {
+		if (idle_vrefresh == 30)
+			/* 60Hz -> 30Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00);
+		else if (idle_vrefresh == 10)
+			/* 60Hz -> 10Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x01, 0x00, 0x00);
+		else
+			/* 60Hz -> 1Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x01, 0x03, 0x00);
+	} else if (vrefresh == 60) {
+		if (idle_vrefresh == 30)
+			/* 60Hz -> 30Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x01, 0x00, 0x00);
+		else if (idle_vrefresh == 10)
+			/* 60Hz -> 10Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x01, 0x01, 0x00);
+		else
+			/* 60Hz -> 1Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x01, 0x01, 0x03);
+	} else {
+		if (idle_vrefresh == 30)
+			/* 120Hz -> 30Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00);
+		else if (idle_vrefresh == 10)
+			/* 120Hz -> 10Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x03, 0x00);
+		else
+			/* 120Hz -> 1Hz idle */
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x01, 0x03);
+	}
+	HK3_SEQ_ADD(seq, 0xBD, 0xA3);
+}
+
+static void hk3_ref_frame_manual(struct hk3_cmd_seq *seq, bool ns, u32 vrefresh)
+{
+	u8 val;
+
+	HK3_SEQ_ADD(seq, 0xBD, 0x21);
+	if (ns) {
+		if (vrefresh == 1)
+			val = 0x1F;
+		else if (vrefresh == 5)
+			val = 0x1E;
+		else if (vrefresh == 10)
+			val = 0x1B;
+		else if (vrefresh == 30)
+			val = 0x19;
+		else /* 60Hz */
+			val = 0x18;
+	} else {
+		if (vrefresh == 1)
+			val = 0x07;
+		else if (vrefresh == 5)
+			val = 0x06;
+		else if (vrefresh == 10)
+			val = 0x03;
+		else if (vrefresh == 30)
+			val = 0x02;
+		else if (vrefresh == 60)
+			val = 0x01;
+		else /* 120Hz */
+			val = 0x00;
+	}
+	HK3_SEQ_ADD(seq, 0x60, val);
+}
+
+static void hk3_expect_seq(struct kunit *test, const struct hk3_cmd_seq *seq,
+			   const struct hk3_cmd_seq *ref, const char *what)
+{
+	KUNIT_EXPECT_EQ_MSG(test, seq->size, ref->size, "%s", what);
+	KUNIT_EXPECT_EQ_MSG(test, memcmp(seq->buf, ref->buf, ref->size), 0,
+			    "%s: %*ph, expected %*ph", what, seq->size, seq->buf,
+			    ref->size, ref->buf);
+}
+
+static int hk3_feat_test_init(struct kunit *test)
+{
+	struct hk3_feat_cmds *cmds;
+
+	cmds = kunit_kzalloc(test, sizeof(*cmds), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, cmds);
+	hk3_fill_feat_cmds(cmds);
+	test->priv = cmds;
+
+	return 0;
+}
+
+static void hk3_feat_test_te(struct kunit *test)
+{
+	const struct hk3_feat_cmds *cmds = test->priv;
+	struct hk3_cmd_seq ref;
+	int fixed, ns;
+
+	for (fixed = 0; fixed < 2; fixed++) {
+		for (ns = 0; ns < 2; ns++) {
+			memset(&ref, 0, sizeof(ref));
+			hk3_ref_te(&ref, fixed, ns);
+			hk3_expect_seq(test, &cmds->te[fixed][ns], &ref,
+				       fixed ? (ns ? "te fixed ns" : "te fixed hs") :
+					       (ns ? "te changeable ns" : "te changeable hs"));
+		}
+	}
+}
+
+static void hk3_feat_test_irc(struct kunit *test)
+{
+	const struct hk3_feat_cmds *cmds = test->priv;
+	struct hk3_cmd_seq ref;
+	int irc, set;
+
+	for (irc = 0; irc < HK3_IRC_MAX; irc++) {
+		for (set = 0; set < 2; set++) {
+			memset(&ref, 0, sizeof(ref));
+			hk3_ref_irc(&ref, irc, set);
+			hk3_expect_seq(test, &cmds->irc[irc][set], &ref, "irc");
+		}
+	}
+}
+
+static void hk3_feat_test_op(struct kunit *test)
+{
+	const struct hk3_feat_cmds *cmds = test->priv;
+	struct hk3_cmd_seq ref;
+	int ns;
+
+	for (ns = 0; ns < 2; ns++) {
+		memset(&ref, 0, sizeof(ref));
+		hk3_ref_op(&ref, ns);
+		hk3_expect_seq(test, &cmds->op[ns], &ref, ns ? "op ns" : "op hs");
+	}
+}
+
+static void hk3_feat_test_early_exit(struct kunit *test)
+{
+	const struct hk3_feat_cmds *cmds = test->priv;
+	struct hk3_cmd_seq ref;
+	int ee, ns, hbm;
+
+	for (ee = 0; ee < 2; ee++) {
+		for (ns = 0; ns < 2; ns++) {
+			for (hbm = 0; hbm < 2; hbm++) {
+				memset(&ref, 0, sizeof(ref));
+				hk3_ref_early_exit(&ref, ee, ns, hbm);
+				hk3_expect_seq(test, &cmds->early_exit[ee][ns][hbm], &ref,
+					       "early exit");
+			}
+		}
+	}
+}
+
+/*
+ * The branch based code only knew idle rates of 1Hz, 10Hz and 30Hz. Entries of the rates
+ * added after it have no reference, and are only checked to be built exactly when they
+ * can be reached.
+ */
+static bool hk3_ref_has_idle_rate(u32 idle_vrefresh)
+{
+	return idle_vrefresh == 1 || idle_vrefresh == 10 || idle_vrefresh == 30;
+}
+
+static void hk3_feat_test_frame_auto(struct kunit *test)
+{
+	const struct hk3_feat_cmds *cmds = test->priv;
+	struct hk3_cmd_seq ref;
+	int ns, hbm, init, idle;
+
+	for (ns = 0; ns < 2; ns++) {
+		for (hbm = 0; hbm < 2; hbm++) {
+			for (init = 0; init < HK3_AUTO_INIT_FREQ_MAX; init++) {
+				for (idle = 0; idle < HK3_AUTO_IDLE_FREQ_MAX; idle++) {
+					const struct hk3_idle_rate *rate = &hk3_idle_rates[idle];
+					const struct hk3_cmd_seq *seq =
+						&cmds->frame_auto[ns][hbm][init][idle];
+
+					if (ns && !rate->ns) {
+						KUNIT_EXPECT_EQ(test, seq->size, 0);
+						continue;
+					}
+					KUNIT_EXPECT_NE(test, seq->size, 0);
+					if (!hk3_ref_has_idle_rate(rate->vrefresh))
+						continue;
+
+					memset(&ref, 0, sizeof(ref));
+					hk3_ref_frame_auto(&ref, ns, hbm, hk3_auto_init_freqs[init],
+							   rate->vrefresh);
+					hk3_expect_seq(test, seq, &ref, "frame auto");
+				}
+			}
+		}
+	}
+}
+
+static void hk3_feat_test_frame_manual(struct kunit *test)
+{
+	const struct hk3_feat_cmds *cmds = test->priv;
+	struct hk3_cmd_seq ref;
+	int ns, i;
+
+	for (ns = 0; ns < 2; ns++) {
+		for (i = 0; i < HK3_MANUAL_FREQ_MAX; i++) {
+			memset(&ref, 0, sizeof(ref));
+			hk3_ref_frame_manual(&ref, ns, hk3_manual_freqs[i]);
+			hk3_expect_seq(test, &cmds->frame_manual[ns][i], &ref, "frame manual");
+		}
+	}
+}
+
+static struct kunit_case hk3_feat_test_cases[] = {
+	KUNIT_CASE(hk3_feat_test_te),
+	KUNIT_CASE(hk3_feat_test_irc),
+	KUNIT_CASE(hk3_feat_test_op),
+	KUNIT_CASE(hk3_feat_test_early_exit),
+	KUNIT_CASE(hk3_feat_test_frame_auto),
+	KUNIT_CASE(hk3_feat_test_frame_manual),
+	{}
+};
+
+static struct kunit_suite hk3_feat_test_suite = {
+	.name = "hk3-feat",
+	.init = hk3_feat_test_init,
+	.test_cases = hk3_feat_test_cases,
+};
+
+kunit_test_suite(hk3_feat_test_suite);
+
+MODULE_IMPORT_NS(EXPORTED_FOR_KUNIT_TESTING);
+MODULE_DESCRIPTION("KUnit tests of the HK3 panel feature command tables");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Prebuilt panel feature commands of HK3 AMOLED panel.
+ *
+ * Copyright (c) 2022 Google LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The tables are built by the driver, and shared with its KUnit tests.
+ */
+
+#ifndef HK3_FEAT_H
+#define HK3_FEAT_H
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+
+#include "kunit-visibility.h"
+
+/**
+ * enum hk3_irc - IRC command sets
+ * @HK3_IRC_PROTO: IRC on/off before EVT1, switched by FEAT_IRC_OFF
+ * @HK3_IRC_FLAT: flat/flat Z mode of EVT1 and later, switched by FEAT_IRC_Z_MODE
+ * @HK3_IRC_FLAT_E6: flat/flat Z mode of material E6
+ * @HK3_IRC_MAX: placeholder, counter for number of IRC command sets
+ */
+enum hk3_irc {
+	HK3_IRC_PROTO = 0,
+	HK3_IRC_FLAT,
+	HK3_IRC_FLAT_E6,
+	HK3_IRC_MAX
+};
+
+/**
+ * struct hk3_idle_rate - idle target of auto frame insertion
+ * @vrefresh: idle refresh rate, dividing 240 since targets are counted in 240Hz ticks
+ * @ns: whether it can be reached in NS, i.e. it's a divisor of 60Hz
+ * @path: frame insertion path towards it, by [120Hz HS, 60Hz HS, NS]
+ *
+ * A target between two steps of the step setting takes the path of the lower step.
+ */
+struct hk3_idle_rate {
+	u32 vrefresh;
+	bool ns;
+	u8 path[3][3];
+};
+
+/* number of entries in hk3_idle_rates, hk3_auto_init_freqs and hk3_manual_freqs */
+#define HK3_AUTO_IDLE_FREQ_MAX	5
+#define HK3_AUTO_INIT_FREQ_MAX	2
+#define HK3_MANUAL_FREQ_MAX	6
+
+#define HK3_CMD_SEQ_SIZE 64
+
+/**
+ * struct hk3_cmd_seq - DCS commands built ahead to be queued in one go
+ * @size: number of bytes used in @buf
+ * @buf: the commands, each one prefixed by its length
+ */
+struct hk3_cmd_seq {
+	u8 size;
+	u8 buf[HK3_CMD_SEQ_SIZE];
+};
+
+#define HK3_SEQ_ADD(seq, bytes...) do {		\
+	const u8 d[] = { bytes };		\
+	hk3_seq_add(seq, d, ARRAY_SIZE(d));	\
+} while (0)
+
+/**
+ * struct hk3_feat_cmds - commands of hk3_set_panel_feat() for every input
+ *
+ * Each sub-block of the panel feature sequence only depends on a few feature
+ * bits and refresh rates, so all of its variants are built at probe, and a
+ * feature update becomes table lookups and bulk copies into the DCS buffer.
+ */
+struct hk3_feat_cmds {
+	/** @te: TE setting, by [fixed TE][FEAT_OP_NS] */
+	struct hk3_cmd_seq te[2][2];
+	/** @irc: IRC setting, by [enum hk3_irc][FEAT_IRC_OFF or FEAT_IRC_Z_MODE] */
+	struct hk3_cmd_seq irc[HK3_IRC_MAX][2];
+	/** @op: operating mode, by [FEAT_OP_NS] */
+	struct hk3_cmd_seq op[2];
+	/** @early_exit: early exit setting, by [FEAT_EARLY_EXIT][FEAT_OP_NS][FEAT_HBM] */
+	struct hk3_cmd_seq early_exit[2][2][2];
+	/**
+	 * @frame_auto: auto frame setting, by [FEAT_OP_NS][FEAT_HBM][init freq][idle rate],
+	 *		left empty for idle rates not reachable in NS
+	 */
+	struct hk3_cmd_seq frame_auto[2][2][HK3_AUTO_INIT_FREQ_MAX][HK3_AUTO_IDLE_FREQ_MAX];
+	/** @frame_manual: manual frame setting, by [FEAT_OP_NS][freq] */
+	struct hk3_cmd_seq frame_manual[2][HK3_MANUAL_FREQ_MAX];
+};
+
+#if IS_ENABLED(CONFIG_KUNIT)
+extern const struct hk3_idle_rate hk3_idle_rates[HK3_AUTO_IDLE_FREQ_MAX];
+extern const u32 hk3_auto_init_freqs[HK3_AUTO_INIT_FREQ_MAX];
+extern const u32 hk3_manual_freqs[HK3_MANUAL_FREQ_MAX];
+
+void hk3_seq_add(struct hk3_cmd_seq *seq, const u8 *cmd, u8 len);
+void hk3_fill_feat_cmds(struct hk3_feat_cmds *cmds);
+#endif
+
+#endif /* HK3_FEAT_H */
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * KUnit tests of the HK3 power state routes.
+ *
+ * Copyright (c) 2022 Google LLC
+ */
+
+#include <kunit/test.h>
+#include <linux/module.h>
+
+#include "hk3-state.h"
+
+static int hk3_state_test_init(struct kunit *test)
+{
+	struct hk3_state_routes *routes;
+
+	routes = kunit_kzalloc(test, sizeof(*routes), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, routes);
+	hk3_state_build_routes(routes);
+	test->priv = routes;
+
+	return 0;
+}
+
+/* AOD is entered right from normal mode, not through blank */
+static void hk3_state_test_normal_to_lp(struct kunit *test)
+{
+	const struct hk3_state_route *r =
+		hk3_state_get_route(test->priv, HK3_STATE_NORMAL, HK3_STATE_LP);
+
+	KUNIT_ASSERT_TRUE(test, r->valid);
+	KUNIT_EXPECT_EQ(test, r->hops, 1);
+	KUNIT_EXPECT_EQ(test, r->next, HK3_STATE_LP);
+	KUNIT_EXPECT_EQ(test, r->cmds, (u32)(HK3_SCMD_FEAT_OFF | HK3_SCMD_DISPLAY_OFF |
+					     HK3_SCMD_AOD_ON | HK3_SCMD_DISPLAY_ON));
+	KUNIT_EXPECT_EQ(test, r->cost_frames, 2);
+}
+
+static void hk3_state_test_blank_to_off(struct kunit *test)
+{
+	const struct hk3_state_route *r =
+		hk3_state_get_route(test->priv, HK3_STATE_BLANK, HK3_STATE_OFF);
+
+	KUNIT_ASSERT_TRUE(test, r->valid);
+	KUNIT_EXPECT_EQ(test, r->hops, 1);
+	KUNIT_EXPECT_EQ(test, r->next, HK3_STATE_OFF);
+	KUNIT_EXPECT_EQ(test, r->cmds, (u32)HK3_SCMD_SLEEP_IN);
+}
+
+/* every state is reachable from every other one, and following next gets there */
+static void hk3_state_test_all_routes(struct kunit *test)
+{
+	const struct hk3_state_routes *routes = test->priv;
+	int from, to, hops;
+
+	for (from = 0; from < HK3_STATE_MAX; from++) {
+		for (to = 0; to < HK3_STATE_MAX; to++) {
+			const struct hk3_state_route *r = hk3_state_get_route(routes, from, to);
+			enum hk3_state state = from;
+
+			KUNIT_EXPECT_TRUE_MSG(test, r->valid, "%s -> %s", hk3_state_name(from),
+					      hk3_state_name(to));
+			if (!r->valid || from == to)
+				continue;
+
+			for (hops = 0; hops < r->hops && state != to; hops++)
+				state = hk3_state_get_route(routes, state, to)->next;
+			KUNIT_EXPECT_EQ_MSG(test, state, to, "%s -> %s", hk3_state_name(from),
+					    hk3_state_name(to));
+			KUNIT_EXPECT_EQ_MSG(test, hops, r->hops, "%s -> %s",
+					    hk3_state_name(from), hk3_state_name(to));
+		}
+	}
+}
+
+static struct kunit_case hk3_state_test_cases[] = {
+	KUNIT_CASE(hk3_state_test_normal_to_lp),
+	KUNIT_CASE(hk3_state_test_blank_to_off),
+	KUNIT_CASE(hk3_state_test_all_routes),
+	{}
+};
+
+static struct kunit_suite hk3_state_test_suite = {
+	.name = "hk3-state",
+	.init = hk3_state_test_init,
+	.test_cases = hk3_state_test_cases,
+};
+
+kunit_test_suite(hk3_state_test_suite);
+
+MODULE_IMPORT_NS(EXPORTED_FOR_KUNIT_TESTING);
+MODULE_DESCRIPTION("KUnit tests of the HK3 power state routes");
+MODULE_LICENSE("GPL");
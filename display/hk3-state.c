@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Power state transitions of HK3 AMOLED panel.
+ *
+ * Copyright (c) 2022 Google LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Only depends on the transition table below, so routes can be checked without
+ * panel hardware.
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#include "hk3-state.h"
+#include "kunit-visibility.h"
+
+static const struct hk3_state_edge hk3_state_edges[] = {
+	/* sleep out with 10ms delay, 110ms delay after VREG setting */
+	{ HK3_STATE_OFF, HK3_STATE_BLANK, HK3_SCMD_RESET, 8 },
+	{ HK3_STATE_BLANK, HK3_STATE_NORMAL, HK3_SCMD_FEAT | HK3_SCMD_DISPLAY_ON, 1 },
+	/* mode change without blanking, e.g. resolution switch */
+	{ HK3_STATE_NORMAL, HK3_STATE_NORMAL, HK3_SCMD_FEAT, 0 },
+	/* one frame for disabled features to be effective, 20ms after display off */
+	{ HK3_STATE_NORMAL, HK3_STATE_BLANK, HK3_SCMD_FEAT_OFF | HK3_SCMD_DISPLAY_OFF, 3 },
+	/* 100ms delay after sleep in */
+	{ HK3_STATE_BLANK, HK3_STATE_OFF, HK3_SCMD_SLEEP_IN, 6 },
+	/* init sequence has sent display off already */
+	{ HK3_STATE_BLANK, HK3_STATE_LP,
+	  HK3_SCMD_FEAT_OFF | HK3_SCMD_AOD_ON | HK3_SCMD_DISPLAY_ON, 1 },
+	/* shortcut of NORMAL -> BLANK -> LP, no delay after display off */
+	{ HK3_STATE_NORMAL, HK3_STATE_LP,
+	  HK3_SCMD_FEAT_OFF | HK3_SCMD_DISPLAY_OFF | HK3_SCMD_AOD_ON | HK3_SCMD_DISPLAY_ON, 2 },
+	/* switch between LP modes */
+	{ HK3_STATE_LP, HK3_STATE_LP,
+	  HK3_SCMD_FEAT_OFF | HK3_SCMD_DISPLAY_OFF | HK3_SCMD_AOD_ON | HK3_SCMD_DISPLAY_ON, 2 },
+	/* two frames of 30Hz */
+	{ HK3_STATE_LP, HK3_STATE_NORMAL,
+	  HK3_SCMD_DISPLAY_OFF | HK3_SCMD_AOD_OFF | HK3_SCMD_FEAT | HK3_SCMD_DISPLAY_ON, 4 },
+	/* one frame of 30Hz, 20ms after display off */
+	{ HK3_STATE_LP, HK3_STATE_BLANK, HK3_SCMD_FEAT_OFF | HK3_SCMD_DISPLAY_OFF, 4 },
+};
+
+static const char * const hk3_state_names[HK3_STATE_MAX] = {
+	[HK3_STATE_OFF] = "off",
+	[HK3_STATE_BLANK] = "blank",
+	[HK3_STATE_NORMAL] = "normal",
+	[HK3_STATE_LP] = "lp",
+};
+
+const char *hk3_state_name(enum hk3_state state)
+{
+	return state < HK3_STATE_MAX ? hk3_state_names[state] : "unknown";
+}
+EXPORT_SYMBOL_IF_KUNIT(hk3_state_name);
+
+static void hk3_state_set_route(struct hk3_state_route *r, const struct hk3_state_edge *e)
+{
+	r->valid = true;
+	r->hops = 1;
+	r->next = e->to;
+	r->cmds = e->cmds;
+	r->cost_frames = e->cost_frames;
+}
+
+/**
+ * hk3_state_build_routes - compute cheapest routes between all states
+ * @routes: routes to fill
+ *
+ * Route cost is the sum of cost_frames of its transitions, ties are broken by fewer
+ * transitions. A route to the same state is its self transition if there is one,
+ * otherwise an empty route.
+ */
+void hk3_state_build_routes(struct hk3_state_routes *routes)
+{
+	struct hk3_state_route (*r)[HK3_STATE_MAX] = routes->route;
+	int i, j, k;
+
+	memset(routes, 0, sizeof(*routes));
+
+	for (i = 0; i < HK3_STATE_MAX; i++) {
+		r[i][i].valid = true;
+		r[i][i].next = i;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(hk3_state_edges); i++) {
+		const struct hk3_state_edge *e = &hk3_state_edges[i];
+
+		hk3_state_set_route(&r[e->from][e->to], e);
+	}
+
+	/* self transitions are only taken explicitly, don't extend them */
+	for (k = 0; k < HK3_STATE_MAX; k++) {
+		for (i = 0; i < HK3_STATE_MAX; i++) {
+			if (i == k || !r[i][k].valid)
+				continue;
+			for (j = 0; j < HK3_STATE_MAX; j++) {
+				u16 cost;
+				u8 hops;
+
+				if (j == k || j == i || !r[k][j].valid)
+					continue;
+
+				cost = r[i][k].cost_frames + r[k][j].cost_frames;
+				hops = r[i][k].hops + r[k][j].hops;
+				if (r[i][j].valid && (r[i][j].cost_frames < cost ||
+				    (r[i][j].cost_frames == cost && r[i][j].hops <= hops)))
+					continue;
+
+				r[i][j].valid = true;
+				r[i][j].hops = hops;
+				r[i][j].next = r[i][k].next;
+				r[i][j].cmds = r[i][k].cmds | r[k][j].cmds;
+				r[i][j].cost_frames = cost;
+			}
+		}
+	}
+}
+EXPORT_SYMBOL_IF_KUNIT(hk3_state_build_routes);
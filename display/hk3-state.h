@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Power state transitions of HK3 AMOLED panel.
+ *
+ * Copyright (c) 2022 Google LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef HK3_STATE_H
+#define HK3_STATE_H
+
+#include <linux/bits.h>
+#include <linux/types.h>
+
+/**
+ * enum hk3_state - power state of panel hardware
+ * @HK3_STATE_OFF: panel is reset or in sleep, registers are lost
+ * @HK3_STATE_BLANK: panel is initialized and out of sleep, display is off
+ * @HK3_STATE_NORMAL: display is on in normal mode
+ * @HK3_STATE_LP: display is on in AOD mode
+ * @HK3_STATE_MAX: placeholder, counter for number of states
+ */
+enum hk3_state {
+	HK3_STATE_OFF = 0,
+	HK3_STATE_BLANK,
+	HK3_STATE_NORMAL,
+	HK3_STATE_LP,
+	HK3_STATE_MAX,
+};
+
+/**
+ * enum hk3_state_cmd - command steps of a transition
+ * @HK3_SCMD_RESET: reset panel and send init sequence
+ * @HK3_SCMD_FEAT_OFF: disable panel features before display off or AOD
+ * @HK3_SCMD_DISPLAY_OFF: send display off
+ * @HK3_SCMD_SLEEP_IN: enter sleep mode
+ * @HK3_SCMD_AOD_ON: enter AOD mode and apply its settings
+ * @HK3_SCMD_AOD_OFF: exit AOD mode
+ * @HK3_SCMD_FEAT: apply panel features, display mode and frequency of normal mode
+ * @HK3_SCMD_DISPLAY_ON: send display on
+ *
+ * Steps are run in the order above when a route combines several transitions.
+ */
+enum hk3_state_cmd {
+	HK3_SCMD_RESET = BIT(0),
+	HK3_SCMD_FEAT_OFF = BIT(1),
+	HK3_SCMD_DISPLAY_OFF = BIT(2),
+	HK3_SCMD_SLEEP_IN = BIT(3),
+	HK3_SCMD_AOD_ON = BIT(4),
+	HK3_SCMD_AOD_OFF = BIT(5),
+	HK3_SCMD_FEAT = BIT(6),
+	HK3_SCMD_DISPLAY_ON = BIT(7),
+};
+
+/**
+ * struct hk3_state_edge - legal transition between two states
+ * @from: state before transition
+ * @to: state after transition
+ * @cmds: command steps, mask of enum hk3_state_cmd
+ * @cost_frames: estimated time of the transition in frames of 60Hz, used as its cost
+ *
+ * The driver runs each step in @cmds with the waits the step needs, @cost_frames only
+ * ranks routes.
+ */
+struct hk3_state_edge {
+	enum hk3_state from;
+	enum hk3_state to;
+	u32 cmds;
+	u8 cost_frames;
+};
+
+/**
+ * struct hk3_state_route - cheapest way from a state to another one
+ * @valid: whether the target state is reachable
+ * @hops: number of transitions
+ * @next: state after the first transition
+ * @cmds: command steps of all transitions, mask of enum hk3_state_cmd
+ * @cost_frames: estimated time of all transitions in frames of 60Hz
+ */
+struct hk3_state_route {
+	bool valid;
+	u8 hops;
+	enum hk3_state next;
+	u32 cmds;
+	u16 cost_frames;
+};
+
+/**
+ * struct hk3_state_routes - routes between all states
+ * @route: routes by [from][to]
+ */
+struct hk3_state_routes {
+	struct hk3_state_route route[HK3_STATE_MAX][HK3_STATE_MAX];
+};
+
+void hk3_state_build_routes(struct hk3_state_routes *routes);
+const char *hk3_state_name(enum hk3_state state);
+
+static inline const struct hk3_state_route *
+hk3_state_get_route(const struct hk3_state_routes *routes, enum hk3_state from,
+		    enum hk3_state to)
+{
+	return &routes->route[from][to];
+}
+
+#endif /* HK3_STATE_H */
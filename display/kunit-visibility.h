@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Visibility of internal symbols to KUnit test modules.
+ *
+ * Copyright (c) 2022 Google LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Same as <kunit/visibility.h> of newer kernels, which is used when it's there. Test
+ * modules import the EXPORTED_FOR_KUNIT_TESTING namespace to use the symbols.
+ */
+
+#ifndef KUNIT_VISIBILITY_H
+#define KUNIT_VISIBILITY_H
+
+#if __has_include(<kunit/visibility.h>)
+#include <kunit/visibility.h>
+#else
+#include <linux/export.h>
+
+#if IS_ENABLED(CONFIG_KUNIT)
+#define VISIBLE_IF_KUNIT
+#define EXPORT_SYMBOL_IF_KUNIT(symbol) EXPORT_SYMBOL_NS(symbol, EXPORTED_FOR_KUNIT_TESTING)
+#else
+#define VISIBLE_IF_KUNIT static
+#define EXPORT_SYMBOL_IF_KUNIT(symbol)
+#endif
+#endif
+
+#endif /* KUNIT_VISIBILITY_H */
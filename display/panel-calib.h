@@ -0,0 +1,186 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Cache of per-panel calibration data read back from OTP.
+ *
+ * Copyright (c) 2022 Google LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Calibration values are fixed per panel, but reading them takes slow LP mode transfers
+ * on the enable path. A driver keeps one cache for the module lifetime, so it survives
+ * panel resets, repeated panel_init and re-probe. Data is tagged with the panel ID and
+ * a CRC, a cache of another panel or a corrupted one is ignored and the values are read
+ * from panel as before. The panel ID itself is always read from panel, as the panel may
+ * be swapped in between.
+ *
+ * To survive module reload as well, the cache is exposed as a hex blob module parameter:
+ * userspace can save it, and restore it through modprobe options or sysfs before the
+ * panel is enabled.
+ */
+
+#ifndef PANEL_CALIB_H
+#define PANEL_CALIB_H
+
+#include <linux/crc32.h>
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/string.h>
+
+#include "panel/panel-samsung-drv.h"
+
+#define PANEL_CALIB_MAGIC	0x424C4350 /* "PCLB" */
+#define PANEL_CALIB_VERSION	1
+#define PANEL_CALIB_DATA_MAX	48
+#define PANEL_CALIB_ID_LEN	sizeof_field(struct exynos_panel, panel_id)
+
+/**
+ * struct panel_calib_blob - persistent format of calibration cache
+ * @magic: PANEL_CALIB_MAGIC
+ * @version: PANEL_CALIB_VERSION
+ * @len: length of @data
+ * @reserved: zero
+ * @panel_id: ID of the panel @data is read from
+ * @data: driver specific calibration data
+ * @crc: crc32 of all fields above
+ */
+struct panel_calib_blob {
+	u32 magic;
+	u8 version;
+	u8 len;
+	u8 reserved[2];
+	char panel_id[PANEL_CALIB_ID_LEN];
+	u8 data[PANEL_CALIB_DATA_MAX];
+	u32 crc;
+} __packed;
+
+/**
+ * struct panel_calib - calibration cache of a driver
+ * @lock: protects all fields below
+ * @blob: calibration data, valid if its crc matches
+ */
+struct panel_calib {
+	struct mutex lock;
+	struct panel_calib_blob blob;
+};
+
+#define DEFINE_PANEL_CALIB(name)					\
+	struct panel_calib name = { .lock = __MUTEX_INITIALIZER(name.lock) }
+
+static inline u32 panel_calib_crc(const struct panel_calib_blob *b)
+{
+	return crc32_le(~0, (const u8 *)b, offsetof(struct panel_calib_blob, crc));
+}
+
+static inline bool panel_calib_blob_valid(const struct panel_calib_blob *b)
+{
+	return b->magic == PANEL_CALIB_MAGIC && b->version == PANEL_CALIB_VERSION &&
+	       b->len <= PANEL_CALIB_DATA_MAX && b->crc == panel_calib_crc(b);
+}
+
+/**
+ * panel_calib_load - fill in calibration data from cache
+ * @c: calibration cache
+ * @ctx: panel struct, its panel ID has to be read already
+ * @data: destination
+ * @len: length of @data
+ *
+ * Return: true if the cache is valid and belongs to this panel, false if the data has
+ *	   to be read from panel.
+ */
+static inline bool panel_calib_load(struct panel_calib *c, struct exynos_panel *ctx,
+				    void *data, size_t len)
+{
+	const struct panel_calib_blob *b = &c->blob;
+	bool hit;
+
+	if (!ctx->panel_id[0])
+		return false;
+
+	mutex_lock(&c->lock);
+	hit = panel_calib_blob_valid(b) && b->len == len &&
+	      !strncmp(b->panel_id, ctx->panel_id, PANEL_CALIB_ID_LEN);
+	if (hit)
+		memcpy(data, b->data, len);
+	mutex_unlock(&c->lock);
+
+	dev_dbg(ctx->dev, "calibration cache %s\n", hit ? "hit" : "miss");
+
+	return hit;
+}
+
+/* save calibration @data of @len bytes read from panel */
+static inline void panel_calib_store(struct panel_calib *c, struct exynos_panel *ctx,
+				     const void *data, size_t len)
+{
+	struct panel_calib_blob *b = &c->blob;
+
+	if (!ctx->panel_id[0] || WARN_ON(len > PANEL_CALIB_DATA_MAX))
+		return;
+
+	mutex_lock(&c->lock);
+	memset(b, 0, sizeof(*b));
+	b->magic = PANEL_CALIB_MAGIC;
+	b->version = PANEL_CALIB_VERSION;
+	b->len = len;
+	strscpy(b->panel_id, ctx->panel_id, sizeof(b->panel_id));
+	memcpy(b->data, data, len);
+	b->crc = panel_calib_crc(b);
+	mutex_unlock(&c->lock);
+}
+
+static int __maybe_unused panel_calib_param_set(const char *val, const struct kernel_param *kp)
+{
+	struct panel_calib *c = kp->arg;
+	struct panel_calib_blob b;
+	size_t len = strlen(val);
+
+	if (len && val[len - 1] == '\n')
+		len--;
+
+	/* empty value drops the cache */
+	if (!len) {
+		memset(&b, 0, sizeof(b));
+	} else {
+		if (len != sizeof(b) * 2 || hex2bin((u8 *)&b, val, sizeof(b)))
+			return -EINVAL;
+		if (!panel_calib_blob_valid(&b))
+			return -EINVAL;
+	}
+
+	mutex_lock(&c->lock);
+	c->blob = b;
+	mutex_unlock(&c->lock);
+
+	return 0;
+}
+
+static int __maybe_unused panel_calib_param_get(char *buf, const struct kernel_param *kp)
+{
+	struct panel_calib *c = kp->arg;
+	int len = 0;
+
+	mutex_lock(&c->lock);
+	if (panel_calib_blob_valid(&c->blob)) {
+		bin2hex(buf, &c->blob, sizeof(c->blob));
+		len = sizeof(c->blob) * 2;
+	}
+	mutex_unlock(&c->lock);
+	buf[len++] = '\n';
+
+	return len;
+}
+
+static const struct kernel_param_ops panel_calib_param_ops __maybe_unused = {
+	.set = panel_calib_param_set,
+	.get = panel_calib_param_get,
+};
+
+/* expose cache @c as module parameter "calib" */
+#define PANEL_CALIB_MODULE_PARAM(c)					\
+	module_param_cb(calib, &panel_calib_param_ops, &(c), 0600);	\
+	MODULE_PARM_DESC(calib, "panel calibration cache, hex blob")
+
+#endif /* PANEL_CALIB_H */
@@ -16,6 +16,9 @@
 
 #include "include/trace/dpu_trace.h"
 #include "panel/panel-samsung-drv.h"
+#include "panel-calib.h"
+#include "panel-key.h"
+#include "panel-read.h"
 
 #define BIGSURF_DDIC_ID_LEN 8
 #define BIGSURF_DIMMING_FRAME 32
@@ -75,10 +78,26 @@ struct bigsurf_panel {
 	ktime_t idle_exit_dimming_delay_ts;
 	/** @panel_brightness: the brightness of the panel */
 	u16 panel_brightness;
+	/** @cmd2_page: CMD2 page select session */
+	struct panel_key cmd2_page;
 };
 
 #define to_spanel(ctx) container_of(ctx, struct bigsurf_panel, base)
 
+/*
+ * Select CMD2 @page. Within a scope of BIGSURF_PAGE_BEGIN() and BIGSURF_PAGE_END(),
+ * selecting the page already selected is dropped. Page selects have no counterpart to
+ * close them, so the end of a scope sends nothing.
+ */
+#define BIGSURF_CMD2_PAGE(ctx, page) do {					\
+	const u8 d[] = { 0xF0, 0x55, 0xAA, 0x52, 0x08, page };			\
+	if (panel_key_select(&to_spanel(ctx)->cmd2_page, d, ARRAY_SIZE(d)))	\
+		EXYNOS_DCS_BUF_ADD_SET(ctx, d);					\
+} while (0)
+
+#define BIGSURF_PAGE_BEGIN(ctx)	panel_key_begin(&to_spanel(ctx)->cmd2_page)
+#define BIGSURF_PAGE_END(ctx)	panel_key_put(&to_spanel(ctx)->cmd2_page)
+
 static const struct exynos_dsi_cmd bigsurf_lp_cmds[] = {
 	/* Disable the Black insertion in AoD */
 	EXYNOS_DSI_CMD_SEQ(0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00),
@@ -373,6 +392,7 @@ static void bigsurf_update_irc(struct exynos_panel *ctx,
 		return;
 	}
 
+	BIGSURF_PAGE_BEGIN(ctx);
 	if (IS_HBM_ON_IRC_OFF(hbm_mode)) {
 		if (ctx->panel_rev >= PANEL_REV_EVT1 &&
 		    level == ctx->desc->brt_capability->hbm.level.max)
@@ -380,7 +400,7 @@ static void bigsurf_update_irc(struct exynos_panel *ctx,
 		EXYNOS_DCS_BUF_ADD(ctx, 0x5F, 0x01);
 		if (vrefresh == 120) {
 			if (ctx->hbm.local_hbm.enabled) {
-				EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+				BIGSURF_CMD2_PAGE(ctx, 0x00);
 				EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x04);
 				EXYNOS_DCS_BUF_ADD(ctx, 0xC0, 0x76);
 			}
@@ -388,18 +408,18 @@ static void bigsurf_update_irc(struct exynos_panel *ctx,
 			EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_SET_GAMMA_CURVE, 0x02);
 		} else {
 			EXYNOS_DCS_BUF_ADD(ctx, 0x2F, 0x30);
-			EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+			BIGSURF_CMD2_PAGE(ctx, 0x00);
 			EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0xB0);
 			EXYNOS_DCS_BUF_ADD(ctx, 0xBA, 0x44);
 		}
-		EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+		BIGSURF_CMD2_PAGE(ctx, 0x00);
 		EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x03);
 		EXYNOS_DCS_BUF_ADD(ctx, 0xC0, 0x32);
 	} else {
 		EXYNOS_DCS_BUF_ADD(ctx, 0x5F, 0x00);
 		if (vrefresh == 120) {
 			if (ctx->hbm.local_hbm.enabled) {
-				EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+				BIGSURF_CMD2_PAGE(ctx, 0x00);
 				EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x04);
 				EXYNOS_DCS_BUF_ADD(ctx, 0xC0, 0x75);
 			}
@@ -407,11 +427,11 @@ static void bigsurf_update_irc(struct exynos_panel *ctx,
 			EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_SET_GAMMA_CURVE, 0x00);
 		} else {
 			EXYNOS_DCS_BUF_ADD(ctx, 0x2F, 0x30);
-			EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+			BIGSURF_CMD2_PAGE(ctx, 0x00);
 			EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0xB0);
 			EXYNOS_DCS_BUF_ADD(ctx, 0xBA, 0x41);
 		}
-		EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+		BIGSURF_CMD2_PAGE(ctx, 0x00);
 		EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x03);
 		EXYNOS_DCS_BUF_ADD(ctx, 0xC0, 0x30);
 		if (ctx->panel_rev >= PANEL_REV_EVT1) {
@@ -423,6 +443,7 @@ static void bigsurf_update_irc(struct exynos_panel *ctx,
 	}
 	/* Empty command is for flush */
 	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0x00);
+	BIGSURF_PAGE_END(ctx);
 }
 
 static bool bigsurf_rr_need_te_high(struct exynos_panel *ctx,
@@ -455,19 +476,21 @@ static void bigsurf_change_frequency(struct exynos_panel *ctx,
 		ctx->hbm.local_hbm.effective_state = LOCAL_HBM_DISABLED;
 	}
 
+	BIGSURF_PAGE_BEGIN(ctx);
 	if (!IS_HBM_ON(ctx->hbm_mode)) {
 		if (vrefresh == 120) {
 			EXYNOS_DCS_BUF_ADD(ctx, 0x2F, 0x00);
 			EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, MIPI_DCS_SET_GAMMA_CURVE, 0x00);
 		} else {
 			EXYNOS_DCS_BUF_ADD(ctx, 0x2F, 0x30);
-			EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+			BIGSURF_CMD2_PAGE(ctx, 0x00);
 			EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0xB0);
 			EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xBA, 0x41);
 		}
 	} else {
 		bigsurf_update_irc(ctx, ctx->hbm_mode, vrefresh);
 	}
+	BIGSURF_PAGE_END(ctx);
 
 	dev_dbg(ctx->dev, "%s: change to %uhz\n", __func__, vrefresh);
 }
@@ -497,12 +520,14 @@ static void bigsurf_set_nolp_mode(struct exynos_panel *ctx,
 		return;
 
 	/* exit AOD */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+	BIGSURF_PAGE_BEGIN(ctx);
+	BIGSURF_CMD2_PAGE(ctx, 0x00);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xC0, 0x54);
 	EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_EXIT_IDLE_MODE);
 	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0x5A, 0x04);
 
 	bigsurf_change_frequency(ctx, pmode);
+	BIGSURF_PAGE_END(ctx);
 	spanel->idle_exit_dimming_delay_ts = ktime_add_us(
 		ktime_get(), 100 + EXYNOS_VREFRESH_TO_PERIOD_USEC(vrefresh) * 2);
 
@@ -514,7 +539,7 @@ static void bigsurf_dimming_frame_setting(struct exynos_panel *ctx, u8 dimming_f
 	if (!dimming_frame)
 		dimming_frame = 0x01;
 
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+	BIGSURF_CMD2_PAGE(ctx, 0x00);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB2, 0x19);
 	EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x05);
 	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xB2, dimming_frame, dimming_frame);
@@ -542,7 +567,7 @@ static int bigsurf_enable(struct drm_panel *panel)
 	if (!pmode->exynos_mode.is_lp_mode) {
 		if (ctx->panel_rev < PANEL_REV_EVT1) {
 			/* Gamma update setting */
-			EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x02);
+			BIGSURF_CMD2_PAGE(ctx, 0x02);
 			EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xCC, 0x10);
 			exynos_panel_msleep(9);
 		}
@@ -646,7 +671,7 @@ static void bigsurf_pre_update_ffc(struct exynos_panel *ctx)
 	DPU_ATRACE_BEGIN(__func__);
 
 	/* FFC off */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x01);
+	BIGSURF_CMD2_PAGE(ctx, 0x01);
 	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xC3, 0x00);
 
 	DPU_ATRACE_END(__func__);
@@ -659,6 +684,7 @@ static void bigsurf_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 
 	DPU_ATRACE_BEGIN(__func__);
 
+	BIGSURF_PAGE_BEGIN(ctx);
 	if (hs_clk != MIPI_DSI_FREQ_DEFAULT && hs_clk != MIPI_DSI_FREQ_ALTERNATIVE) {
 		dev_warn(ctx->dev, "invalid hs_clk=%d for FFC\n", hs_clk);
 	} else if (ctx->dsi_hs_clk != hs_clk) {
@@ -666,7 +692,7 @@ static void bigsurf_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 		ctx->dsi_hs_clk = hs_clk;
 
 		/* Update FFC */
-		EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x01);
+		BIGSURF_CMD2_PAGE(ctx, 0x01);
 		if (hs_clk == MIPI_DSI_FREQ_DEFAULT)
 			EXYNOS_DCS_BUF_ADD(ctx, 0xC3, 0x00, 0x06, 0x20, 0x0C, 0xFF,
 						0x00, 0x06, 0x20, 0x0C, 0xFF, 0x00,
@@ -686,8 +712,9 @@ static void bigsurf_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 	}
 
 	/* FFC on */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x01);
+	BIGSURF_CMD2_PAGE(ctx, 0x01);
 	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xC3, 0xDD);
+	BIGSURF_PAGE_END(ctx);
 
 	DPU_ATRACE_END(__func__);
 }
@@ -706,7 +733,7 @@ static void bigsurf_set_local_hbm_background_brightness(struct exynos_panel *ctx
 	val2 = level & 0xff;
 
 	/* set LHBM background brightness */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+	BIGSURF_CMD2_PAGE(ctx, 0x00);
 	EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x4C);
 	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xDF, val1, val2, val1, val2, val1, val2);
 }
@@ -742,7 +769,7 @@ static int bigsurf_set_brightness(struct exynos_panel *ctx, u16 br)
 	if ((ctx->panel_rev < PANEL_REV_MP) &&
 	    ((old_brightness < LHBM_COMPENSATION_THRESHOLD) ^ (br < LHBM_COMPENSATION_THRESHOLD))) {
 		low_to_high = old_brightness < LHBM_COMPENSATION_THRESHOLD;
-		EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x08);
+		BIGSURF_CMD2_PAGE(ctx, 0x08);
 		EXYNOS_DCS_BUF_ADD(ctx, 0xD0, 0x44, 0x00, 0x00, 0x44, 0x00,
 					0x00, 0x44, 0x00, 0x00, 0x04,
 					0x00, low_to_high ? 0x46: 0x4A,
@@ -820,7 +847,7 @@ static void bigsurf_set_local_hbm_brightness(struct exynos_panel *ctx, bool is_f
 	dev_dbg(ctx->dev, "set %s brightness: [%d] %*ph\n",
 		ctl->overdrived ? "overdrive" : "normal",
 		ctl->overdrived ? group : -1, LHBM_BRT_LEN, brt);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, bigsurf_cmd2_page2);
+	BIGSURF_CMD2_PAGE(ctx, 0x02);
 	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, cmd);
 }
 
@@ -833,10 +860,11 @@ static void bigsurf_set_local_hbm_mode(struct exynos_panel *ctx,
 	if (local_hbm_en) {
 		u16 level = exynos_panel_get_brightness(ctx);
 
+		BIGSURF_PAGE_BEGIN(ctx);
 		if (IS_HBM_ON(ctx->hbm_mode)) {
 			bigsurf_update_irc(ctx, ctx->hbm_mode, vrefresh);
 		} else if (vrefresh == 120) {
-			EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+			BIGSURF_CMD2_PAGE(ctx, 0x00);
 			EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x04);
 			EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xC0, 0x75);
 		} else {
@@ -845,6 +873,7 @@ static void bigsurf_set_local_hbm_mode(struct exynos_panel *ctx,
 		}
 		bigsurf_set_local_hbm_background_brightness(ctx, level);
 		bigsurf_set_local_hbm_brightness(ctx, true);
+		BIGSURF_PAGE_END(ctx);
 		EXYNOS_DCS_WRITE_SEQ(ctx, 0x87, 0x05);
 	} else {
 		EXYNOS_DCS_WRITE_SEQ(ctx, 0x87, 0x00);
@@ -887,19 +916,21 @@ static void bigsurf_get_panel_rev(struct exynos_panel *ctx, u32 id)
 	exynos_panel_get_panel_rev(ctx, main | sub);
 }
 
+/* LHBM normal brightness, kept across re-probe and module reload */
+static DEFINE_PANEL_CALIB(bigsurf_calib);
+PANEL_CALIB_MODULE_PARAM(bigsurf_calib);
+
 static int bigsurf_read_id(struct exynos_panel *ctx)
 {
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
-	char buf[BIGSURF_DDIC_ID_LEN] = {0};
+	u8 buf[BIGSURF_DDIC_ID_LEN] = {0};
+	struct panel_read read = PANEL_READ(PANEL_READ_NO_GPARA, 0xF2, buf, BIGSURF_DDIC_ID_LEN);
 	int ret;
 
 	EXYNOS_DCS_WRITE_SEQ(ctx, 0xFF, 0xAA, 0x55, 0xA5, 0x81);
-	ret = mipi_dsi_dcs_read(dsi, 0xF2, buf, BIGSURF_DDIC_ID_LEN);
-	if (ret != BIGSURF_DDIC_ID_LEN) {
+	ret = panel_read_batch(ctx, &read, 1);
+	if (ret) {
 		dev_warn(ctx->dev, "Unable to read DDIC id (%d)\n", ret);
 		goto done;
-	} else {
-		ret = 0;
 	}
 
 	exynos_bin2hex(buf, BIGSURF_DDIC_ID_LEN,
@@ -1053,17 +1084,22 @@ static void _update_lhbm_overdrive_brightness(struct exynos_panel *ctx,
 
 static void bigsurf_lhbm_brightness_init(struct exynos_panel *ctx)
 {
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
 	struct bigsurf_panel *spanel = to_spanel(ctx);
 	int ret;
 	enum bigsurf_lhbm_brt_overdrive_group grp;
 	u8 *p_norm = spanel->lhbm_ctl.brt_normal;
-
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, bigsurf_cmd2_page2);
-	ret = mipi_dsi_dcs_read(dsi, bigsurf_lhbm_brightness_reg, p_norm, LHBM_BRT_LEN);
-	if (ret != LHBM_BRT_LEN) {
-		dev_err(ctx->dev, "failed to read lhbm brightness ret=%d\n", ret);
-		return;
+	struct panel_read read = PANEL_READ(PANEL_READ_NO_GPARA, bigsurf_lhbm_brightness_reg,
+					    p_norm, LHBM_BRT_LEN);
+
+	if (!panel_calib_load(&bigsurf_calib, ctx, p_norm, LHBM_BRT_LEN)) {
+		/* no global para to flush the page select */
+		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, bigsurf_cmd2_page2);
+		ret = panel_read_batch(ctx, &read, 1);
+		if (ret) {
+			dev_err(ctx->dev, "failed to read lhbm brightness ret=%d\n", ret);
+			return;
+		}
+		panel_calib_store(&bigsurf_calib, ctx, p_norm, LHBM_BRT_LEN);
 	}
 	dev_dbg(ctx->dev, "lhbm normal brightness: %*ph\n", LHBM_BRT_LEN, p_norm);
 
@@ -9,17 +9,28 @@
  * published by the Free Software Foundation.
  */
 
+#include <drm/drm_atomic.h>
 #include <drm/drm_vblank.h>
+#include <linux/completion.h>
 #include <linux/debugfs.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/of_platform.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
 #include <linux/thermal.h>
+#include <linux/uaccess.h>
 #include <video/mipi_display.h>
 
 #include "include/trace/dpu_trace.h"
 #include "include/trace/panel_trace.h"
 #include "panel/panel-samsung-drv.h"
 #include "exposure-adj.h"
+#include "hk3-feat.h"
+#include "hk3-state.h"
+#include "panel-calib.h"
+#include "panel-key.h"
+#include "panel-read.h"
 
 /**
  * enum hk3_panel_feature - features supported by this panel
@@ -107,15 +118,364 @@ struct hk3_lhbm_ctl {
 #define HK3_VREG_STR_SIZE 11
 #define HK3_VREG_PARAM_NUM 5
 
+#define HK3_ACL_ZA_THRESHOLD_DBV_P1_0 3917
+#define HK3_ACL_ZA_THRESHOLD_DBV_P1_1 3781
+#define HK3_ACL_ENHANCED_THRESHOLD_DBV 3865
+#define HK3_ACL_NORMAL_THRESHOLD_DBV_1 3570
+#define HK3_ACL_NORMAL_THRESHOLD_DBV_2 3963
+
+#define HK3_ACL_LEVELS_MAX 2
+
 /**
- * HK3_VREG_STR
- * @ctx: exynos_panel struct
+ * struct hk3_acl_level - ACL setting applied from a DBV in HBM
+ * @min_dbv: lowest DBV of the level
+ * @setting: ACL setting, 0 for unused levels
+ */
+struct hk3_acl_level {
+	u16 min_dbv;
+	u8 setting;
+};
+
+/**
+ * struct hk3_rev_variant - settings depending on panel revision
+ * @min_rev: lowest panel revision the settings apply to
+ * @irc_feat: feature switching IRC in HBM, FEAT_IRC_OFF or FEAT_IRC_Z_MODE
+ * @irc_names: IRC states for logging, by [@irc_feat]
+ * @irc_flat: whether flat/flat Z mode IRC commands are used, which depend on material
+ * @acl_normal: ACL levels of ACL_NORMAL, in ascending order of DBV
+ * @acl_enhanced: ACL levels of ACL_ENHANCED, in ascending order of DBV
+ * @za_val: LP setting of zonal attenuation if it's enabled
+ * @za_by_opr: whether zonal attenuation also depends on OPR
+ * @za_follows_acl: whether zonal attenuation is updated on ACL changes, or kept off
+ * @vreg: expected Vreg setting read back after self refresh
+ * @thermal_comp: whether temperature compensation is applied
+ * @lhbm_opr_setting: whether LHBM luminance OPR setting is needed at init
+ * @negative_field: whether negative field setting is needed at init
+ * @aod_transition: whether AOD transition setting is needed at init
+ */
+struct hk3_rev_variant {
+	u32 min_rev;
+	enum hk3_panel_feature irc_feat;
+	const char *irc_names[2];
+	bool irc_flat;
+	struct hk3_acl_level acl_normal[HK3_ACL_LEVELS_MAX];
+	struct hk3_acl_level acl_enhanced[HK3_ACL_LEVELS_MAX];
+	u8 za_val;
+	bool za_by_opr;
+	bool za_follows_acl;
+	const char *vreg;
+	bool thermal_comp;
+	bool lhbm_opr_setting;
+	bool negative_field;
+	bool aod_transition;
+};
+
+/*
+ * ACL mode and setting:
+ *
+ * P1.0
+ *    NORMAL/ENHANCED- 5% (0x01)
+ * P1.1
+ *    NORMAL/ENHANCED- 7.5% (0x02)
+ *
+ * P1.2 and P2 take the levels of EVT1, but keep the IRC and zonal
+ * attenuation handling of earlier revisions
+ *
+ * EVT1 and later
+ *    ENHANCED   - 17%  (0x03)
+ *    NORMAL     - 12%  (0x02)
+ *               - 7.5% (0x01)
+ *
+ * Zonal attenuation LP setting - 0x21 or 0x11: 7.5%, 0x00: off
  *
  * Expect to have five values for the Vreg parameters:
  * EVT1.1 and earlier: 0x1B
  * DVT1 and later: 0x1A
  */
-#define HK3_VREG_STR(ctx) (((ctx)->panel_rev >= PANEL_REV_DVT1) ? "1a1a1a1a1a" : "1b1b1b1b1b")
+static const struct hk3_rev_variant hk3_rev_variants[] = {
+	{
+		.min_rev = PANEL_REV_PROTO1,
+		.irc_feat = FEAT_IRC_OFF,
+		.irc_names = { "on", "off" },
+		.acl_normal = { { HK3_ACL_ZA_THRESHOLD_DBV_P1_0, 0x01 } },
+		.acl_enhanced = { { HK3_ACL_ZA_THRESHOLD_DBV_P1_0, 0x01 } },
+		.za_val = 0x21,
+		.za_by_opr = true,
+		.za_follows_acl = true,
+		.vreg = "1b1b1b1b1b",
+		.lhbm_opr_setting = true,
+		.aod_transition = true,
+	},
+	{
+		.min_rev = PANEL_REV_PROTO1_1,
+		.irc_feat = FEAT_IRC_OFF,
+		.irc_names = { "on", "off" },
+		.acl_normal = { { HK3_ACL_ZA_THRESHOLD_DBV_P1_1, 0x02 } },
+		.acl_enhanced = { { HK3_ACL_ZA_THRESHOLD_DBV_P1_1, 0x02 } },
+		.za_val = 0x11,
+		.za_follows_acl = true,
+		.vreg = "1b1b1b1b1b",
+		.aod_transition = true,
+	},
+	{
+		.min_rev = PANEL_REV_PROTO1_2,
+		.irc_feat = FEAT_IRC_OFF,
+		.irc_names = { "on", "off" },
+		.acl_normal = {
+			{ HK3_ACL_NORMAL_THRESHOLD_DBV_1, 0x01 },
+			{ HK3_ACL_NORMAL_THRESHOLD_DBV_2, 0x02 },
+		},
+		.acl_enhanced = { { HK3_ACL_ENHANCED_THRESHOLD_DBV, 0x03 } },
+		.za_val = 0x11,
+		.za_follows_acl = true,
+		.vreg = "1b1b1b1b1b",
+		.aod_transition = true,
+	},
+	{
+		.min_rev = PANEL_REV_EVT1,
+		.irc_feat = FEAT_IRC_Z_MODE,
+		.irc_names = { "flat", "flat_z" },
+		.irc_flat = true,
+		.acl_normal = {
+			{ HK3_ACL_NORMAL_THRESHOLD_DBV_1, 0x01 },
+			{ HK3_ACL_NORMAL_THRESHOLD_DBV_2, 0x02 },
+		},
+		.acl_enhanced = { { HK3_ACL_ENHANCED_THRESHOLD_DBV, 0x03 } },
+		.za_val = 0x11,
+		.vreg = "1b1b1b1b1b",
+		.aod_transition = true,
+	},
+	{
+		.min_rev = PANEL_REV_EVT1_1,
+		.irc_feat = FEAT_IRC_Z_MODE,
+		.irc_names = { "flat", "flat_z" },
+		.irc_flat = true,
+		.acl_normal = {
+			{ HK3_ACL_NORMAL_THRESHOLD_DBV_1, 0x01 },
+			{ HK3_ACL_NORMAL_THRESHOLD_DBV_2, 0x02 },
+		},
+		.acl_enhanced = { { HK3_ACL_ENHANCED_THRESHOLD_DBV, 0x03 } },
+		.za_val = 0x11,
+		.vreg = "1b1b1b1b1b",
+		.thermal_comp = true,
+		.aod_transition = true,
+	},
+	{
+		.min_rev = PANEL_REV_DVT1,
+		.irc_feat = FEAT_IRC_Z_MODE,
+		.irc_names = { "flat", "flat_z" },
+		.irc_flat = true,
+		.acl_normal = {
+			{ HK3_ACL_NORMAL_THRESHOLD_DBV_1, 0x01 },
+			{ HK3_ACL_NORMAL_THRESHOLD_DBV_2, 0x02 },
+		},
+		.acl_enhanced = { { HK3_ACL_ENHANCED_THRESHOLD_DBV, 0x03 } },
+		.za_val = 0x11,
+		.vreg = "1a1a1a1a1a",
+		.thermal_comp = true,
+		.negative_field = true,
+	},
+};
+
+/**
+ * struct hk3_material_desc - settings depending on panel material
+ * @id: material ID read from panel, in the format of hk3_get_panel_material()
+ * @material: the material
+ * @irc_e6: whether flat/flat Z mode IRC uses the commands of E6
+ * @ns_gamma_fix: whether NS gamma fix is needed at init
+ */
+struct hk3_material_desc {
+	u32 id;
+	enum hk3_material material;
+	bool irc_e6;
+	bool ns_gamma_fix;
+};
+
+static const struct hk3_material_desc hk3_materials[] = {
+	{ .id = 0x000A4000, .material = MATERIAL_E6, .irc_e6 = true },
+	{ .id = 0x000A4020, .material = MATERIAL_E7_DOE, .ns_gamma_fix = true },
+	{ .id = 0x000A4420, .material = MATERIAL_E7 },
+	{ .id = 0x000A4520, .material = MATERIAL_LPC5 },
+};
+
+/* used if material is unknown */
+#define HK3_MATERIAL_DEFAULT (&hk3_materials[2])
+
+/**
+ * struct hk3_variant - revision and material dependent settings of the panel
+ * @rev: settings of panel revision
+ * @material: settings of panel material
+ * @irc: IRC commands of the panel, by [@rev->irc_feat]
+ *
+ * Bound at probe and again once panel revision and material are read, so runtime
+ * paths look settings up here instead of checking revision or material.
+ */
+struct hk3_variant {
+	const struct hk3_rev_variant *rev;
+	const struct hk3_material_desc *material;
+	const struct hk3_cmd_seq *irc;
+};
+
+#define HK3_DIMMING_CMD_LEN 4
+#define HK3_DIMMING_SEGMENTS_MAX 16
+
+/**
+ * struct hk3_dimming_segment - dimming setting of a brightness range
+ * @min_brightness: lowest requested brightness of the range, which ends at the next segment
+ * @cmd: commands by [FEAT_HBM][NS or below 120Hz][FEAT_EARLY_EXIT], bit 7 of the first byte
+ *	 is set for the ones without early exit
+ */
+struct hk3_dimming_segment {
+	u16 min_brightness;
+	u8 cmd[2][2][2][HK3_DIMMING_CMD_LEN];
+};
+
+/**
+ * struct hk3_dimming_profile - dimming freq commands, immutable once published
+ * @rcu: for freeing it once readers are done after it's replaced
+ * @num_segments: number of valid entries in @segments, at least one
+ * @segments: sorted by min_brightness, and the first one starts at 0
+ */
+struct hk3_dimming_profile {
+	struct rcu_head rcu;
+	u32 num_segments;
+	struct hk3_dimming_segment segments[HK3_DIMMING_SEGMENTS_MAX];
+};
+
+#define HK3_SHADOW_ENTRIES_MAX 16
+#define HK3_SHADOW_DATA_MAX 12
+
+/**
+ * struct hk3_shadow_entry - bytes last written into a register
+ * @offset: global parameter offset of the first byte
+ * @reg: the register
+ * @len: number of bytes in @data
+ * @data: the bytes
+ */
+struct hk3_shadow_entry {
+	u16 offset;
+	u8 reg;
+	u8 len;
+	u8 data[HK3_SHADOW_DATA_MAX];
+};
+
+/**
+ * struct hk3_shadow - DDIC register contents known from previous writes
+ * @num: number of valid entries in @entries
+ * @entries: known register contents, non-overlapping
+ * @regs: registers having entries
+ * @saved_bytes: bytes of writes dropped since the contents were already there
+ * @saved_bytes_mark: @saved_bytes at @mark_ts
+ * @mark_ts: when the saving rate was reported last time
+ */
+struct hk3_shadow {
+	u32 num;
+	struct hk3_shadow_entry entries[HK3_SHADOW_ENTRIES_MAX];
+	DECLARE_BITMAP(regs, 256);
+	u64 saved_bytes;
+	u64 saved_bytes_mark;
+	ktime_t mark_ts;
+};
+
+/**
+ * struct hk3_feat_plan - panel feature update resolved ahead of sending it
+ * @valid: whether the plan is built
+ * @hw_seq: &hk3_panel.hw_feat_seq the plan is built at
+ * @feat: requested features
+ * @vrefresh: requested refresh rate
+ * @idle_vrefresh: requested idle refresh rate
+ * @override: whether dimming is from the dimming profile
+ * @brightness: requested brightness the dimming command is picked for
+ * @profile_seq: dimming profile version the dimming command is picked from
+ * @force_changeable_te: changeable TE override the TE setting is picked with
+ * @hw_feat: panel features the plan applies on
+ * @hw_vrefresh: refresh rate the plan applies on
+ * @hw_idle_vrefresh: idle refresh rate the plan applies on
+ * @hw_early_exit_seq: early-exit commands the plan applies on
+ * @hw_frame_seq: frequency setting commands the plan applies on
+ * @hw_dimming_cmd: dimming freq command the plan applies on
+ * @changed_feat: features to update
+ * @skip: whether there is nothing to send
+ * @te: TE setting to send, or NULL
+ * @irc: IRC setting to send, or NULL
+ * @op: operating mode setting to send, or NULL
+ * @send_dimming: whether to send @dimming_cmd
+ * @dimming_cmd: dimming freq command after the update
+ * @early_exit: early-exit commands after the update, sent if @send_early_exit
+ * @send_early_exit: whether to send @early_exit, which also resends all blocks after it
+ * @frame: frequency setting commands after the update
+ * @send_frame: whether to send @frame
+ *
+ * Built from the requested state and the panel state it applies on, so it can be built
+ * ahead for the likely next update and sent as is if both still match.
+ */
+struct hk3_feat_plan {
+	bool valid;
+	u32 hw_seq;
+	DECLARE_BITMAP(feat, FEAT_MAX);
+	u32 vrefresh;
+	u32 idle_vrefresh;
+	bool override;
+	u16 brightness;
+	u32 profile_seq;
+	bool force_changeable_te;
+	DECLARE_BITMAP(hw_feat, FEAT_MAX);
+	u32 hw_vrefresh;
+	u32 hw_idle_vrefresh;
+	const struct hk3_cmd_seq *hw_early_exit_seq;
+	const struct hk3_cmd_seq *hw_frame_seq;
+	u8 hw_dimming_cmd[HK3_DIMMING_CMD_LEN];
+	DECLARE_BITMAP(changed_feat, FEAT_MAX);
+	bool skip;
+	const struct hk3_cmd_seq *te;
+	const struct hk3_cmd_seq *irc;
+	const struct hk3_cmd_seq *op;
+	bool send_dimming;
+	u8 dimming_cmd[HK3_DIMMING_CMD_LEN];
+	const struct hk3_cmd_seq *early_exit;
+	bool send_early_exit;
+	const struct hk3_cmd_seq *frame;
+	bool send_frame;
+};
+
+/**
+ * enum hk3_lowprio_item - non-urgent panel updates deferred to idle windows
+ * @HK3_LOWPRIO_THERM: thermal gain for burn-in compensation
+ * @HK3_LOWPRIO_ZA: zonal attenuation following ACL or OPR
+ * @HK3_LOWPRIO_VREG: read back of Vreg setting after display on
+ * @HK3_LOWPRIO_HIST: LHBM histogram ROI setup
+ * @HK3_LOWPRIO_MAX: placeholder, counter for number of items
+ */
+enum hk3_lowprio_item {
+	HK3_LOWPRIO_THERM = 0,
+	HK3_LOWPRIO_ZA,
+	HK3_LOWPRIO_VREG,
+	HK3_LOWPRIO_HIST,
+	HK3_LOWPRIO_MAX,
+};
+
+/* queue delay buckets: below 1ms, 2ms, 4ms ... and the last one unbounded */
+#define HK3_LOWPRIO_DELAY_BUCKETS 8
+
+/**
+ * struct hk3_lowprio - queue of non-urgent panel updates
+ * @pending: queued items, bitmap of enum hk3_lowprio_item
+ * @queued_ts: when each pending item is queued first
+ * @work: drains the queue in an idle window, see hk3_lowprio_queue()
+ * @delay_hist: number of drained items by queue delay
+ * @max_delay_us: the longest queue delay seen
+ *
+ * Items are panel states to sync rather than commands, so an item queued again before
+ * it's drained is only sent once, with the state at drain time. Draining runs under
+ * mode_lock as urgent updates do, so it can't send anything older than what they sent.
+ */
+struct hk3_lowprio {
+	unsigned long pending;
+	ktime_t queued_ts[HK3_LOWPRIO_MAX];
+	struct delayed_work work;
+	u32 delay_hist[HK3_LOWPRIO_DELAY_BUCKETS];
+	u32 max_delay_us;
+};
 
 /**
  * struct hk3_panel - panel specific info
@@ -131,6 +491,34 @@ struct hk3_panel {
 	DECLARE_BITMAP(feat, FEAT_MAX);
 	/** @hw_feat: correlated states effective in panel */
 	DECLARE_BITMAP(hw_feat, FEAT_MAX);
+	/** @feat_cmds: commands of panel feature updates, built at probe */
+	const struct hk3_feat_cmds *feat_cmds;
+	/** @hw_early_exit_seq: early-exit commands effective in panel, NULL if unknown */
+	const struct hk3_cmd_seq *hw_early_exit_seq;
+	/** @hw_frame_seq: frequency setting commands effective in panel, NULL if unknown */
+	const struct hk3_cmd_seq *hw_frame_seq;
+	/** @hw_dimming_cmd: dimming freq command effective in panel */
+	u8 hw_dimming_cmd[HK3_DIMMING_CMD_LEN];
+	/** @dimming_profile: dimming freq commands used while panel is on, RCU protected */
+	const struct hk3_dimming_profile __rcu *dimming_profile;
+	/** @dimming_profile_lock: serializes updates of @dimming_profile */
+	struct mutex dimming_profile_lock;
+	/** @dimming_profile_seq: bumped whenever @dimming_profile is replaced */
+	u32 dimming_profile_seq;
+	/** @next_plan: feature update prebuilt for the likely next state after a commit */
+	struct hk3_feat_plan next_plan;
+	/** @prebuild_work: builds @next_plan off the commit path */
+	struct work_struct prebuild_work;
+	/** @hw_feat_seq: bumped whenever panel features are sent, to tell a stale plan */
+	u32 hw_feat_seq;
+	/** @next_plan_hits: feature updates sent from @next_plan */
+	u32 next_plan_hits;
+	/** @next_plan_misses: feature updates not matching @next_plan while it's built */
+	u32 next_plan_misses;
+	/** @shadow: register contents written, reset on panel reset and sleep in */
+	struct hk3_shadow shadow;
+	/** @key_f0: F0 test key session, see hk3_key_get() */
+	struct panel_key key_f0;
 	/** @hw_vrefresh: vrefresh rate effective in panel */
 	u32 hw_vrefresh;
 	/** @hw_idle_vrefresh: idle vrefresh rate effective in panel */
@@ -154,19 +542,47 @@ struct hk3_panel {
 	bool force_za_off;
 	/** @requested_brightness: requested brightness before exposure adjustment */
 	u16 requested_brightness;
+	/** @ea: exposure adjustment state */
+	struct exposure_adj ea;
+	/** @txn_dirty: HK3_TXN_* states marked in this commit, sent by hk3_txn_commit() */
+	u32 txn_dirty;
+	/** @txn_dbv: brightness level marked by HK3_TXN_DBV */
+	u16 txn_dbv;
+	/**
+	 * @txn_work: sends marked states and staged exposure adjustment if the frame commit
+	 *	      in flight doesn't get to commit_done
+	 */
+	struct delayed_work txn_work;
+	/** @txn_frozen: @txn_work isn't scheduled while LHBM is being turned on */
+	bool txn_frozen;
+	/** @lowprio: non-urgent updates kept off the commit and self refresh paths */
+	struct hk3_lowprio lowprio;
+	/** @op_hz_ts: when the pending op_hz switch is requested, 0 if none */
+	ktime_t op_hz_ts;
+	/** @op_hz_sent: operating mode commands of the pending op_hz switch are sent */
+	bool op_hz_sent;
+	/** @op_hz_switch_us: latency from the last op_hz request to the frame it latches in */
+	u32 op_hz_switch_us;
+	/** @hw_state: power state of panel hardware */
+	enum hk3_state hw_state;
+	/** @state_routes: cheapest transitions between power states, built at probe */
+	struct hk3_state_routes state_routes;
+	/** @dsi_packets: DSI packets sent for panel state updates since probe */
+	u32 dsi_packets;
+	/** @commit_dsi_packets: DSI packets sent for panel state updates in the last commit */
+	u32 commit_dsi_packets;
+	/** @commit_dsi_packets_mark: @dsi_packets at the end of the last commit */
+	u32 commit_dsi_packets_mark;
 	/** @lhbm_ctl: lhbm brightness control */
 	struct hk3_lhbm_ctl lhbm_ctl;
 	/** @material: the material version used in panel */
 	enum hk3_material material;
+	/** @variant: revision and material dependent settings */
+	struct hk3_variant variant;
 	/** @tz: thermal zone device for reading temperature */
 	struct thermal_zone_device *tz;
 	/** @hw_temp: the temperature applied into panel */
 	u32 hw_temp;
-	/**
-	 * @pending_temp_update: whether there is pending temperature update. It will be
-	 *                       handled in the commit_done function.
-	 */
-	bool pending_temp_update;
 	/**
 	 * @is_pixel_off: pixel-off command is sent to panel. Only sending normal-on or resetting
 	 *		  panel can recover to normal mode after entering pixel-off state.
@@ -177,13 +593,235 @@ struct hk3_panel {
 	/**
 	 * @read_vreg: whether need to read back Vreg setting after self_refresh. The Vreg cannot
 	 *	       be read right after it's set, so we have to wait for taking effect, but
-	 *	       cannot block the main thread.
+	 *	       cannot block the main thread. It's read from the low priority queue.
 	 */
 	bool read_vreg;
 };
 
 #define to_spanel(ctx) container_of(ctx, struct hk3_panel, base)
 
+/* panel states marked during a commit and sent together by hk3_txn_commit() */
+#define HK3_TXN_WRCTRLD	BIT(0)
+#define HK3_TXN_FEAT	BIT(1)
+#define HK3_TXN_DBV	BIT(2)
+#define HK3_TXN_ACL	BIT(3)
+
+/*
+ * Registers kept in shadow. The shadow is only correct while every write of these goes
+ * through HK3_DCS_BUF_ADD_PARAM() or HK3_DCS_BUF_ADD_REG(), or is seen by
+ * hk3_shadow_touch() (the other HK3_DCS_BUF_ADD*() variants, hk3_seq_buf_add() and
+ * hk3_send_cmd_set()). Commands sent by the core driver on its own, like binned LP
+ * commands, aren't seen, so the shadow is reset around them with hk3_shadow_reset().
+ * Add a register here only after checking all of its writers.
+ */
+static const u8 hk3_shadow_regs[] = { 0xB9, 0xF2, 0xF4 };
+
+static bool hk3_shadow_is_tracked(u8 reg)
+{
+	u32 i;
+
+	for (i = 0; i < ARRAY_SIZE(hk3_shadow_regs); i++)
+		if (hk3_shadow_regs[i] == reg)
+			return true;
+	return false;
+}
+
+static void hk3_shadow_reset(struct hk3_shadow *shadow)
+{
+	shadow->num = 0;
+	bitmap_zero(shadow->regs, 256);
+}
+
+/* forget contents of @reg written from @offset for @len bytes, or the whole @reg if @len is 0 */
+static void hk3_shadow_drop(struct hk3_shadow *shadow, u8 reg, u16 offset, u8 len)
+{
+	bool left = false;
+	u32 i = 0;
+
+	if (!test_bit(reg, shadow->regs))
+		return;
+
+	while (i < shadow->num) {
+		struct hk3_shadow_entry *e = &shadow->entries[i];
+
+		if (e->reg != reg) {
+			i++;
+			continue;
+		}
+		if (len && (e->offset >= offset + len || offset >= e->offset + e->len)) {
+			left = true;
+			i++;
+			continue;
+		}
+		*e = shadow->entries[--shadow->num];
+	}
+
+	if (!left)
+		clear_bit(reg, shadow->regs);
+}
+
+/* track a write not going through the shadow, @cmd may be a global parameter offset */
+static void hk3_shadow_touch(struct hk3_shadow *shadow, const u8 *cmd, size_t len)
+{
+	if (len && cmd[0] != 0xB0)
+		hk3_shadow_drop(shadow, cmd[0], 0, 0);
+}
+
+/*
+ * Record writing @cmd from @offset, return true without recording if the register already
+ * has the same contents.
+ */
+static bool hk3_shadow_update(struct hk3_shadow *shadow, u16 offset, const u8 *cmd, size_t len)
+{
+	const u8 reg = cmd[0];
+	struct hk3_shadow_entry *e;
+	u32 i;
+
+	if (len < 2 || len - 1 > HK3_SHADOW_DATA_MAX) {
+		hk3_shadow_drop(shadow, reg, 0, 0);
+		return false;
+	}
+
+	if (test_bit(reg, shadow->regs)) {
+		for (i = 0; i < shadow->num; i++) {
+			e = &shadow->entries[i];
+			if (e->reg == reg && e->offset == offset && e->len == len - 1 &&
+			    !memcmp(e->data, cmd + 1, len - 1))
+				return true;
+		}
+		hk3_shadow_drop(shadow, reg, offset, len - 1);
+	}
+
+	if (shadow->num == HK3_SHADOW_ENTRIES_MAX)
+		return false;
+
+	e = &shadow->entries[shadow->num++];
+	e->reg = reg;
+	e->offset = offset;
+	e->len = len - 1;
+	memcpy(e->data, cmd + 1, len - 1);
+	set_bit(reg, shadow->regs);
+
+	return false;
+}
+
+static void hk3_dcs_write_raw(struct exynos_panel *ctx, const u8 *cmd, size_t len, u16 flags)
+{
+	int ret;
+
+	to_spanel(ctx)->dsi_packets++;
+	ret = exynos_dsi_dcs_write_buffer(to_mipi_dsi_device(ctx->dev), cmd, len, flags);
+	if (ret < 0)
+		dev_err(ctx->dev, "failed to write cmd %#x (%d)\n", cmd[0], ret);
+}
+
+static void hk3_dcs_write(struct exynos_panel *ctx, const u8 *cmd, size_t len, u16 flags)
+{
+	hk3_shadow_touch(&to_spanel(ctx)->shadow, cmd, len);
+	hk3_dcs_write_raw(ctx, cmd, len, flags);
+}
+
+#define HK3_NO_GPARA	(-1)
+
+/*
+ * Queue @cmd written from global parameter @offset, or without one if it's HK3_NO_GPARA,
+ * dropped if the register is in hk3_shadow_regs[] and has the same contents already.
+ */
+static void hk3_dcs_write_param(struct exynos_panel *ctx, int offset, const u8 *cmd,
+				size_t len)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const u8 gpara[] = { 0xB0, (offset >> 8) & 0xFF, offset & 0xFF, cmd[0] };
+	const bool has_gpara = offset != HK3_NO_GPARA;
+
+	if (hk3_shadow_is_tracked(cmd[0]) &&
+	    hk3_shadow_update(&spanel->shadow, has_gpara ? offset : 0, cmd, len)) {
+		spanel->shadow.saved_bytes += len + (has_gpara ? sizeof(gpara) : 0);
+		return;
+	}
+
+	if (has_gpara)
+		hk3_dcs_write_raw(ctx, gpara, sizeof(gpara), MIPI_DSI_MSG_QUEUE);
+	hk3_dcs_write_raw(ctx, cmd, len, MIPI_DSI_MSG_QUEUE);
+}
+
+/* send @set, forgetting contents of the registers it writes */
+static void hk3_send_cmd_set(struct exynos_panel *ctx, const struct exynos_dsi_cmd_set *set)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	u32 i;
+
+	/* command sets toggle the F0 key by themselves, see hk3_key_get() */
+	WARN_ON_ONCE(spanel->key_f0.depth);
+	for (i = 0; i < set->num_cmd; i++)
+		hk3_shadow_touch(&spanel->shadow, set->cmds[i].cmd, set->cmds[i].cmd_len);
+	exynos_panel_send_cmd_set(ctx, set);
+}
+
+/*
+ * EXYNOS_DCS_BUF_ADD*() variants counting packets of panel state updates, and keeping
+ * register shadow in sync, see hk3_shadow_regs[] for the rule they rely on.
+ */
+#define HK3_DCS_BUF_ADD(ctx, seq...) do {				\
+	const u8 d[] = { seq };						\
+	hk3_dcs_write(ctx, d, ARRAY_SIZE(d), MIPI_DSI_MSG_QUEUE);	\
+} while (0)
+
+#define HK3_DCS_BUF_ADD_AND_FLUSH(ctx, seq...) do {			\
+	const u8 d[] = { seq };						\
+	hk3_dcs_write(ctx, d, ARRAY_SIZE(d), 0);			\
+} while (0)
+
+#define HK3_DCS_BUF_ADD_SET(ctx, set)					\
+	hk3_dcs_write(ctx, set, ARRAY_SIZE(set), MIPI_DSI_MSG_QUEUE)
+
+#define HK3_DCS_BUF_ADD_SET_AND_FLUSH(ctx, set)				\
+	hk3_dcs_write(ctx, set, ARRAY_SIZE(set), 0)
+
+/* write @reg from global parameter @offset, skipped if it has the same contents */
+#define HK3_DCS_BUF_ADD_PARAM(ctx, offset, reg, data...) do {		\
+	const u8 d[] = { reg, data };					\
+	hk3_dcs_write_param(ctx, offset, d, ARRAY_SIZE(d));		\
+} while (0)
+
+/* write @reg without global parameter, skipped if it has the same contents */
+#define HK3_DCS_BUF_ADD_REG(ctx, reg, data...)				\
+	HK3_DCS_BUF_ADD_PARAM(ctx, HK3_NO_GPARA, reg, data)
+
+static const u8 unlock_cmd_f0[] = { 0xF0, 0x5A, 0x5A };
+static const u8 lock_cmd_f0[]   = { 0xF0, 0xA5, 0xA5 };
+
+/*
+ * Open an F0 key scope. The key is only unlocked once per session, so helpers take their
+ * own scope and don't care whether the caller has unlocked it.
+ */
+static void hk3_key_get(struct exynos_panel *ctx)
+{
+	if (panel_key_get(&to_spanel(ctx)->key_f0, unlock_cmd_f0, ARRAY_SIZE(unlock_cmd_f0)))
+		HK3_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+}
+
+/* open a scope unlocking F0 only if something in it needs to, see hk3_commit_done() */
+static void hk3_key_begin(struct exynos_panel *ctx)
+{
+	panel_key_begin(&to_spanel(ctx)->key_f0);
+}
+
+/*
+ * Close an F0 key scope. The outermost one locks the key, flushed if @flush is set, so
+ * commands of inner scopes are only flushed along with the outermost one.
+ */
+static void hk3_key_put(struct exynos_panel *ctx, bool flush)
+{
+	if (!panel_key_put(&to_spanel(ctx)->key_f0))
+		return;
+
+	if (flush)
+		HK3_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	else
+		HK3_DCS_BUF_ADD_SET(ctx, lock_cmd_f0);
+}
+
 /* 1344x2992 */
 static const struct drm_dsc_config wqhd_pps_config = {
 	.line_buf_depth = 9,
@@ -333,21 +971,17 @@ static const struct drm_dsc_config fhd_pps_config = {
 #define MIPI_DSI_FREQ_ALTERNATIVE 1346
 
 /*
- * When segmented dimming is enabled, brightness higher than this is treated as
- * high brightness and uses freq_cmd_high_brightness for backlight control.
- * Otherwise freq_cmd is used.
- *
- * This feature is not turned on by default, and the default value is not tuned.
+ * Frames the DDIC takes to dim to a new brightness level while dimming is on, bits 5:0 of
+ * the second byte of the dimming freq command
  */
-#define HK3_DIMMING_SWITCH_THRESHOLD_DEFAULT   600
+#define HK3_DIMMING_CMD_FRAMES(cmd)	((cmd)[1] & 0x3F)
 
 #define PROJECT "HK3"
 
-static const u8 unlock_cmd_f0[] = { 0xF0, 0x5A, 0x5A };
-static const u8 lock_cmd_f0[]   = { 0xF0, 0xA5, 0xA5 };
 static const u8 freq_update[] = { 0xF7, 0x0F };
 static const u8 lhbm_brightness_index[] = { 0xB0, 0x03, 0x21, 0x95 };
 static const u8 lhbm_brightness_reg = 0x95;
+static const int lhbm_brightness_offset = 0x0321;
 static const u8 pixel_off[] = { 0x22 };
 static const u8 sync_begin[] = { 0xE4, 0x00, 0x2C, 0x2C, 0xA2, 0x00, 0x00 };
 static const u8 sync_end[] = { 0xE4, 0x00, 0x2C, 0x2C, 0x82, 0x00, 0x00 };
@@ -380,123 +1014,126 @@ static const struct exynos_binned_lp hk3_binned_lp[] = {
 			      HK3_TE2_RISING_EDGE_OFFSET, HK3_TE2_FALLING_EDGE_OFFSET)
 };
 
-int use_linear_matrix = 1;
-module_param(use_linear_matrix, int, 0644);
-
-int use_segmented_dimming = 0;
-module_param(use_segmented_dimming, int, 0644);
-
-int segmented_dimming_switch_threshold = HK3_DIMMING_SWITCH_THRESHOLD_DEFAULT;
-module_param(segmented_dimming_switch_threshold, int, 0644);
+/* LHBM normal brightness, kept across re-probe and module reload */
+static DEFINE_PANEL_CALIB(hk3_calib);
+PANEL_CALIB_MODULE_PARAM(hk3_calib);
 
-u8 freq_cmd[4] = {0x00, 0x43, 0x43, 0x03};
-module_param_array(freq_cmd, byte, NULL, 0644);
+/* commands of both early exit states, indexed by FEAT_EARLY_EXIT */
+#define HK3_DIMMING_CMDS(b0, b1, b2, b3)	{ { (b0) | 0x80, b1, b2, b3 }, { b0, b1, b2, b3 } }
 
-u8 freq_cmd_ns[4] = {0x00, 0x43, 0x43, 0x03};
-module_param_array(freq_cmd_ns, byte, NULL, 0644);
-
-u8 freq_cmd_high_brightness[4] = {0x00, 0x43, 0x43, 0x03};
-module_param_array(freq_cmd_high_brightness, byte, NULL, 0644);
-
-u8 freq_cmd_high_brightness_ns[4] = {0x00, 0x43, 0x43, 0x03};
-module_param_array(freq_cmd_high_brightness_ns, byte, NULL, 0644);
-
-u8 freq_cmd_hbm[4] = {0x00, 0x43, 0x43, 0x03};
-module_param_array(freq_cmd_hbm, byte, NULL, 0644);
-
-u8 freq_cmd_hbm_ns[4] = {0x00, 0x43, 0x43, 0x03};
-module_param_array(freq_cmd_hbm_ns, byte, NULL, 0644);
-
-u8 freq_cmd_hbm_high_brightness[4] = {0x00, 0x43, 0x43, 0x03};
-module_param_array(freq_cmd_hbm_high_brightness, byte, NULL, 0644);
-
-u8 freq_cmd_hbm_high_brightness_ns[4] = {0x00, 0x43, 0x43, 0x03};
-module_param_array(freq_cmd_hbm_high_brightness_ns, byte, NULL, 0644);
-
-struct hk3_freq_cmdset {
-	u8 *cmd;
-	u8 *cmd_ns;
-	u8 *cmd_high_brightness;
-	u8 *cmd_high_brightness_ns;
+/* a single segment over the whole brightness range */
+static const struct hk3_dimming_profile hk3_dimming_profile_default = {
+	.num_segments = 1,
+	.segments[0] = {
+		.min_brightness = 0,
+		.cmd = { [0 ... 1] = { [0 ... 1] = HK3_DIMMING_CMDS(0x00, 0x43, 0x43, 0x03) } },
+	},
 };
 
-enum hk3_freq_cmdset_type {
-	HK3_FREQ_CMDSET_NORMAL,
-	HK3_FREQ_CMDSET_HBM,
-	HK3_FREQ_CMDSET_TYPE_MAX
+/* dimming freq commands used while panel is off or in LP mode, by [FEAT_HBM] */
+static const u8 hk3_default_dimming_cmds[2][2][HK3_DIMMING_CMD_LEN] = {
+	HK3_DIMMING_CMDS(0x01, 0x83, 0x03, 0x03),
+	HK3_DIMMING_CMDS(0x00, 0x83, 0x03, 0x01),
 };
 
-struct hk3_freq_cmdset hk3_freq_cmdsets[HK3_FREQ_CMDSET_TYPE_MAX] = {
-	[HK3_FREQ_CMDSET_NORMAL] = {
-		.cmd = freq_cmd,
-		.cmd_ns = freq_cmd_ns,
-		.cmd_high_brightness = freq_cmd_high_brightness,
-		.cmd_high_brightness_ns = freq_cmd_high_brightness_ns,
-	},
-	[HK3_FREQ_CMDSET_HBM] = {
-		.cmd = freq_cmd_hbm,
-		.cmd_ns = freq_cmd_hbm_ns,
-		.cmd_high_brightness = freq_cmd_hbm_high_brightness,
-		.cmd_high_brightness_ns = freq_cmd_hbm_high_brightness_ns,
-	},
-};
+/* queue hw_dimming_cmd, updated by hk3_update_dimming_cmd(), effective after freq_update */
+static void hk3_queue_dimming_freq_cmd(struct exynos_panel *ctx)
+{
+	const u8 *cmd = to_spanel(ctx)->hw_dimming_cmd;
+
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0x21, cmd[0], cmd[1], cmd[2], cmd[3]);
+}
+
+static void hk3_send_dimming_freq_cmd(struct exynos_panel *ctx)
+{
+	hk3_key_get(ctx);
+	hk3_queue_dimming_freq_cmd(ctx);
+	HK3_DCS_BUF_ADD_SET(ctx, freq_update);
+	hk3_key_put(ctx, true);
+}
 
-static void hk3_send_dimming_freq_cmd(struct exynos_panel *ctx, int need_unlock, const u8 *cmd)
+/* binary search of the segment @br falls in */
+static const struct hk3_dimming_segment *
+hk3_find_dimming_segment(const struct hk3_dimming_profile *profile, u16 br)
 {
-	if (need_unlock)
-		EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+	u32 lo = 0, hi = profile->num_segments;
 
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x21, cmd[0], cmd[1], cmd[2], cmd[3]);
+	/* the first segment starts at 0, find the last one starting at or below @br */
+	while (hi - lo > 1) {
+		const u32 mid = lo + (hi - lo) / 2;
 
-	if (need_unlock) {
-		EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+		if (profile->segments[mid].min_brightness <= br)
+			lo = mid;
+		else
+			hi = mid;
 	}
+
+	return &profile->segments[lo];
 }
 
-static void hk3_set_default_dimming(struct exynos_panel *ctx, const unsigned long *feat, int need_unlock)
+/*
+ * Dimming freq command for @feat at @vrefresh, from the published dimming profile if
+ * @override is set, which must be dereferenced under rcu_read_lock() and is only valid
+ * until rcu_read_unlock().
+ */
+static const u8 *hk3_get_dimming_cmd(struct exynos_panel *ctx, const unsigned long *feat,
+				     u32 vrefresh, bool override)
 {
-	static const u8 cmd[4] = {0x01, 0x83, 0x03, 0x03};
-	static const u8 hbm_cmd[4] = {0x00, 0x83, 0x03, 0x01};
-	u8 target_cmd[4];
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const bool hbm = test_bit(FEAT_HBM, feat);
+	const bool ee = test_bit(FEAT_EARLY_EXIT, feat);
+	const struct hk3_dimming_segment *seg;
+	bool slow;
 
-	if (test_bit(FEAT_HBM, feat))
-		memcpy(target_cmd, hbm_cmd, 4);
-	else
-		memcpy(target_cmd, cmd, 4);
+	if (!override)
+		return hk3_default_dimming_cmds[hbm][ee];
 
-	if (!test_bit(FEAT_EARLY_EXIT, feat))
-		target_cmd[0] |= 0x80;
+	seg = hk3_find_dimming_segment(rcu_dereference(spanel->dimming_profile),
+				       spanel->requested_brightness);
+	slow = test_bit(FEAT_OP_NS, feat) || vrefresh < 120;
 
-	hk3_send_dimming_freq_cmd(ctx, need_unlock, target_cmd);
+	return seg->cmd[hbm][slow][ee];
 }
 
-static void hk3_set_override_dimming(struct exynos_panel *ctx, const unsigned long *feat, int need_unlock)
+/* update hw_dimming_cmd for @feat, return whether it's changed */
+static bool hk3_update_dimming_cmd(struct exynos_panel *ctx, const unsigned long *feat,
+				   bool override)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
-	bool is_hbm = test_bit(FEAT_HBM, feat);
-	bool is_ns_mode = test_bit(FEAT_OP_NS, feat);
-	bool is_sub120 = spanel->hw_vrefresh < 120;
-	struct hk3_freq_cmdset *cmdset;
-	u8 *cmd;
-	u8 target_cmd[4];
-
-	if (is_hbm)
-		cmdset = &hk3_freq_cmdsets[HK3_FREQ_CMDSET_HBM];
-	else
-		cmdset = &hk3_freq_cmdsets[HK3_FREQ_CMDSET_NORMAL];
+	const u8 *cmd;
+	bool changed;
+
+	rcu_read_lock();
+	cmd = hk3_get_dimming_cmd(ctx, feat, spanel->hw_vrefresh, override);
+	changed = memcmp(cmd, spanel->hw_dimming_cmd, HK3_DIMMING_CMD_LEN);
+	if (changed) {
+		memcpy(spanel->hw_dimming_cmd, cmd, HK3_DIMMING_CMD_LEN);
+		spanel->hw_feat_seq++;
+	}
+	rcu_read_unlock();
 
-	if (use_segmented_dimming && spanel->requested_brightness > segmented_dimming_switch_threshold)
-		cmd = (is_ns_mode || is_sub120) ? cmdset->cmd_high_brightness_ns : cmdset->cmd_high_brightness;
-	else
-		cmd = (is_ns_mode || is_sub120) ? cmdset->cmd_ns : cmdset->cmd;
+	return changed;
+}
+
+static void hk3_set_default_dimming(struct exynos_panel *ctx, const unsigned long *feat)
+{
+	hk3_update_dimming_cmd(ctx, feat, false);
+	hk3_send_dimming_freq_cmd(ctx);
+}
 
-	memcpy(target_cmd, cmd, 4);
+static void hk3_set_override_dimming(struct exynos_panel *ctx, const unsigned long *feat)
+{
+	hk3_update_dimming_cmd(ctx, feat, true);
+	hk3_send_dimming_freq_cmd(ctx);
+}
 
-	if (!test_bit(FEAT_EARLY_EXIT, feat))
-		cmd[0] |= 0x80;
+/* frames the DDIC dims over with the dimming freq command programmed now */
+static u32 hk3_get_dimming_frames(struct exynos_panel *ctx)
+{
+	if (!ctx->dimming_on)
+		return 0;
 
-	hk3_send_dimming_freq_cmd(ctx, need_unlock, cmd);
+	return HK3_DIMMING_CMD_FRAMES(to_spanel(ctx)->hw_dimming_cmd);
 }
 
 static inline bool is_in_comp_range(int temp)
@@ -514,11 +1151,9 @@ static void hk3_update_disp_therm(struct exynos_panel *ctx)
 	if (IS_ERR_OR_NULL(spanel->tz))
 		return;
 
-	if (ctx->panel_rev < PANEL_REV_EVT1_1 || ctx->panel_state != PANEL_STATE_NORMAL)
+	if (!spanel->variant.rev->thermal_comp || ctx->panel_state != PANEL_STATE_NORMAL)
 		return;
 
-	spanel->pending_temp_update = false;
-
 	ret = thermal_zone_get_temp(spanel->tz, &temp);
 	if (ret) {
 		dev_err(ctx->dev, "%s: fail to read temperature ret:%d\n", __func__, ret);
@@ -533,10 +1168,10 @@ static void hk3_update_disp_therm(struct exynos_panel *ctx)
 	dev_dbg(ctx->dev, "%s: apply gain into ddic at %ddeg c\n", __func__, temp);
 
 	DPU_ATRACE_BEGIN(__func__);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x03, 0x67);
-	EXYNOS_DCS_BUF_ADD(ctx, 0x67, temp);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	hk3_key_get(ctx);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x03, 0x67);
+	HK3_DCS_BUF_ADD(ctx, 0x67, temp);
+	hk3_key_put(ctx, true);
 	DPU_ATRACE_END(__func__);
 
 	spanel->hw_temp = temp;
@@ -557,7 +1192,7 @@ static u8 hk3_get_te2_option(struct exynos_panel *ctx)
 	return HK3_TE2_CHANGEABLE;
 }
 
-static void hk3_update_te2_internal(struct exynos_panel *ctx, bool lock)
+static void hk3_update_te2(struct exynos_panel *ctx)
 {
 	struct exynos_panel_te2_timing timing = {
 		.rising_edge = HK3_TE2_RISING_EDGE_OFFSET,
@@ -599,30 +1234,20 @@ static void hk3_update_te2_internal(struct exynos_panel *ctx, bool lock)
 		ctx->panel_idle_vrefresh ? "active" : "inactive",
 		rising, falling);
 
-	if (lock)
-		EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x42, 0xF2);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF2, 0x0D);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x01, 0xB9);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, option);
+	hk3_key_get(ctx);
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x42, 0xF2, 0x0D);
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x01, 0xB9, option);
 	idx = option == HK3_TE2_FIXED ? 0x22 : 0x1E;
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, idx, 0xB9);
 	if (option == HK3_TE2_FIXED) {
-		EXYNOS_DCS_BUF_ADD(ctx, 0xB9, (rising >> 8) & 0xF, rising & 0xFF,
+		HK3_DCS_BUF_ADD_PARAM(ctx, idx, 0xB9, (rising >> 8) & 0xF, rising & 0xFF,
 			(falling >> 8) & 0xF, falling & 0xFF,
 			(rising >> 8) & 0xF, rising & 0xFF,
 			(falling >> 8) & 0xF, falling & 0xFF);
 	} else {
-		EXYNOS_DCS_BUF_ADD(ctx, 0xB9, (rising >> 8) & 0xF, rising & 0xFF,
+		HK3_DCS_BUF_ADD_PARAM(ctx, idx, 0xB9, (rising >> 8) & 0xF, rising & 0xFF,
 			(falling >> 8) & 0xF, falling & 0xFF);
 	}
-	if (lock)
-		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
-}
-
-static void hk3_update_te2(struct exynos_panel *ctx)
-{
-	hk3_update_te2_internal(ctx, true);
+	hk3_key_put(ctx, true);
 }
 
 static inline bool is_auto_mode_allowed(struct exynos_panel *ctx)
@@ -641,23 +1266,58 @@ static inline bool is_auto_mode_allowed(struct exynos_panel *ctx)
 	return ctx->panel_idle_enabled;
 }
 
+/* in ascending order of refresh rate */
+VISIBLE_IF_KUNIT const struct hk3_idle_rate hk3_idle_rates[HK3_AUTO_IDLE_FREQ_MAX] = {
+	{
+		.vrefresh = 1,
+		.ns = true,
+		.path = { { 0x00, 0x01, 0x03 }, { 0x01, 0x01, 0x03 }, { 0x01, 0x03, 0x00 } },
+	},
+	{
+		.vrefresh = 5,
+		.ns = true,
+		.path = { { 0x00, 0x01, 0x03 }, { 0x01, 0x01, 0x03 }, { 0x01, 0x03, 0x00 } },
+	},
+	{
+		.vrefresh = 10,
+		.ns = true,
+		.path = { { 0x00, 0x03, 0x00 }, { 0x01, 0x01, 0x00 }, { 0x01, 0x00, 0x00 } },
+	},
+	{
+		.vrefresh = 24,
+		.ns = false,
+		.path = { { 0x00, 0x03, 0x00 }, { 0x01, 0x01, 0x00 }, { 0x01, 0x00, 0x00 } },
+	},
+	{
+		.vrefresh = 30,
+		.ns = true,
+		.path = { { 0x00, 0x00, 0x00 }, { 0x01, 0x00, 0x00 }, { 0x00, 0x00, 0x00 } },
+	},
+};
+EXPORT_SYMBOL_IF_KUNIT(hk3_idle_rates);
+
 static u32 hk3_get_min_idle_vrefresh(struct exynos_panel *ctx,
 				     const struct exynos_panel_mode *pmode)
 {
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const bool ns = test_bit(FEAT_OP_NS, spanel->feat);
 	const int vrefresh = drm_mode_vrefresh(&pmode->mode);
 	int min_idle_vrefresh = ctx->min_vrefresh;
+	int i;
 
 	if ((min_idle_vrefresh < 0) || !is_auto_mode_allowed(ctx))
 		return 0;
 
-	if (min_idle_vrefresh <= 1)
-		min_idle_vrefresh = 1;
-	else if (min_idle_vrefresh <= 10)
-		min_idle_vrefresh = 10;
-	else if (min_idle_vrefresh <= 30)
-		min_idle_vrefresh = 30;
-	else
+	/* round up to the closest idle target supported in current operating mode */
+	for (i = 0; i < HK3_AUTO_IDLE_FREQ_MAX; i++) {
+		const struct hk3_idle_rate *rate = &hk3_idle_rates[i];
+
+		if ((rate->ns || !ns) && min_idle_vrefresh <= rate->vrefresh)
+			break;
+	}
+	if (i == HK3_AUTO_IDLE_FREQ_MAX)
 		return 0;
+	min_idle_vrefresh = hk3_idle_rates[i].vrefresh;
 
 	if (min_idle_vrefresh >= vrefresh) {
 		dev_dbg(ctx->dev, "min idle vrefresh (%d) higher than target (%d)\n",
@@ -670,325 +1330,538 @@ static u32 hk3_get_min_idle_vrefresh(struct exynos_panel *ctx,
 	return min_idle_vrefresh;
 }
 
-static void hk3_set_panel_feat(struct exynos_panel *ctx,
-	const u32 vrefresh, const u32 idle_vrefresh, const unsigned long *feat, bool enforce)
+VISIBLE_IF_KUNIT void hk3_seq_add(struct hk3_cmd_seq *seq, const u8 *cmd, u8 len)
 {
-	struct hk3_panel *spanel = to_spanel(ctx);
-	u8 val;
-	DECLARE_BITMAP(changed_feat, FEAT_MAX);
+	if (WARN_ON(seq->size + 1 + len > sizeof(seq->buf)))
+		return;
 
-	if (enforce) {
-		bitmap_fill(changed_feat, FEAT_MAX);
-	} else {
-		bitmap_xor(changed_feat, feat, spanel->hw_feat, FEAT_MAX);
-		if (bitmap_empty(changed_feat, FEAT_MAX) &&
-			vrefresh == spanel->hw_vrefresh &&
-			idle_vrefresh == spanel->hw_idle_vrefresh) {
-			dev_dbg(ctx->dev, "%s: no changes, skip update\n", __func__);
-			return;
-		}
+	seq->buf[seq->size++] = len;
+	memcpy(seq->buf + seq->size, cmd, len);
+	seq->size += len;
+}
+EXPORT_SYMBOL_IF_KUNIT(hk3_seq_add);
+
+/* queue prebuilt commands the way EXYNOS_DCS_BUF_ADD() does */
+static void hk3_seq_buf_add(struct exynos_panel *ctx, const struct hk3_cmd_seq *seq)
+{
+	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
+	unsigned int i;
+	u8 len;
+
+	for (i = 0; i < seq->size; i += len) {
+		len = seq->buf[i++];
+		hk3_shadow_touch(&to_spanel(ctx)->shadow, seq->buf + i, len);
+		exynos_dsi_dcs_write_buffer(dsi, seq->buf + i, len, MIPI_DSI_MSG_QUEUE);
+		to_spanel(ctx)->dsi_packets++;
 	}
+}
 
-	spanel->hw_vrefresh = vrefresh;
-	spanel->hw_idle_vrefresh = idle_vrefresh;
-	bitmap_copy(spanel->hw_feat, feat, FEAT_MAX);
-	dev_dbg(ctx->dev,
-		"op=%s ee=%s hbm=%s irc=%s fi=%s fps=%u idle_fps=%u\n",
-		test_bit(FEAT_OP_NS, feat) ? "ns" : "hs",
-		test_bit(FEAT_EARLY_EXIT, feat) ? "on" : "off",
-		test_bit(FEAT_HBM, feat) ? "on" : "off",
-		ctx->panel_rev >= PANEL_REV_EVT1 ?
-			(test_bit(FEAT_IRC_Z_MODE, feat) ? "flat_z" : "flat") :
-			(test_bit(FEAT_IRC_OFF, feat) ? "off" : "on"),
-		test_bit(FEAT_FRAME_AUTO, feat) ? "auto" : "manual",
-		vrefresh,
-		idle_vrefresh);
+/* init (HS) refresh rates in auto frame mode, in table index order */
+VISIBLE_IF_KUNIT const u32 hk3_auto_init_freqs[HK3_AUTO_INIT_FREQ_MAX] = { 60, 120 };
+EXPORT_SYMBOL_IF_KUNIT(hk3_auto_init_freqs);
+/* refresh rates in manual frame mode, in table index order */
+VISIBLE_IF_KUNIT const u32 hk3_manual_freqs[HK3_MANUAL_FREQ_MAX] = { 1, 5, 10, 30, 60, 120 };
+EXPORT_SYMBOL_IF_KUNIT(hk3_manual_freqs);
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+static void hk3_build_te(struct hk3_cmd_seq *seq, bool fixed, bool ns)
+{
+	if (fixed) {
+		/* Fixed TE */
+		HK3_SEQ_ADD(seq, 0xB9, 0x51);
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x02, 0xB9);
+		HK3_SEQ_ADD(seq, 0xB9, ns ? 0x01 : 0x00);
+		/* Fixed TE width setting */
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x08, 0xB9);
+		if (ns)
+			HK3_SEQ_ADD(seq, 0xB9, 0x0B, 0x43, 0x00, 0x2F, 0x0B, 0x43, 0x00, 0x2F);
+		else
+			HK3_SEQ_ADD(seq, 0xB9, 0x0B, 0xBB, 0x00, 0x2F, 0x0B, 0xBB, 0x00, 0x2F);
+	} else {
+		/* Changeable TE */
+		HK3_SEQ_ADD(seq, 0xB9, 0x04);
+		/* Changeable TE width setting and frequency */
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x04, 0xB9);
+		if (ns)
+			HK3_SEQ_ADD(seq, 0xB9, 0x0B, 0x43, 0x00, 0x2F);
+		else
+			HK3_SEQ_ADD(seq, 0xB9, 0x0B, 0xBB, 0x00, 0x2F);
+	}
+}
 
-	/* TE setting */
-	if (test_bit(FEAT_EARLY_EXIT, changed_feat) ||
-		test_bit(FEAT_OP_NS, changed_feat)) {
-		if (test_bit(FEAT_EARLY_EXIT, feat) && !spanel->force_changeable_te) {
-			/* Fixed TE */
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x51);
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x02, 0xB9);
-			val = test_bit(FEAT_OP_NS, feat) ? 0x01 : 0x00;
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB9, val);
-			/* Fixed TE width setting */
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x08, 0xB9);
-			if (test_bit(FEAT_OP_NS, feat)) {
-				EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x0B, 0x43, 0x00, 0x2F,
-					0x0B, 0x43, 0x00, 0x2F);
-			} else {
-				EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x0B, 0xBB, 0x00, 0x2F,
-					0x0B, 0xBB, 0x00, 0x2F);
-			}
+/*
+ * HBM IRC setting
+ *
+ * Description: after EVT1, IRC will be always on. "Flat mode" is used to
+ * replace IRC on for normal mode and HDR video, and "Flat Z mode" is used
+ * to replace IRC off for sunlight environment.
+ */
+static void hk3_build_irc(struct hk3_cmd_seq *seq, bool is_e6, bool z_mode)
+{
+	HK3_SEQ_ADD(seq, 0xB0, 0x02, 0x00, 0x92);
+	if (z_mode) {
+		if (is_e6) {
+			HK3_SEQ_ADD(seq, 0x92, 0xBE, 0x98);
+			HK3_SEQ_ADD(seq, 0xB0, 0x02, 0xF3, 0x68);
+			HK3_SEQ_ADD(seq, 0x68, 0x97, 0x87, 0x87, 0xFB, 0xFD, 0xF1);
 		} else {
-			/* Changeable TE */
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x04);
-			/* Changeable TE width setting and frequency */
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x04, 0xB9);
-			if (test_bit(FEAT_OP_NS, feat))
-				EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x0B, 0x43, 0x00, 0x2F);
-			else
-				EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x0B, 0xBB, 0x00, 0x2F);
+			HK3_SEQ_ADD(seq, 0x92, 0xF1, 0xC1);
+			HK3_SEQ_ADD(seq, 0xB0, 0x02, 0xF3, 0x68);
+			HK3_SEQ_ADD(seq, 0x68, 0x82, 0x70, 0x23, 0x91, 0x88, 0x3C);
 		}
+	} else {
+		HK3_SEQ_ADD(seq, 0x92, 0x00, 0x00);
+		HK3_SEQ_ADD(seq, 0xB0, 0x02, 0xF3, 0x68);
+		if (is_e6)
+			HK3_SEQ_ADD(seq, 0x68, 0x71, 0x81, 0x59, 0x90, 0xA2, 0x80);
+		else
+			HK3_SEQ_ADD(seq, 0x68, 0x77, 0x81, 0x23, 0x8C, 0x99, 0x3C);
 	}
+}
 
-	/* TE2 setting */
-	if (test_bit(FEAT_OP_NS, changed_feat))
-		hk3_update_te2_internal(ctx, false);
+static void hk3_build_irc_proto(struct hk3_cmd_seq *seq, bool irc_off)
+{
+	HK3_SEQ_ADD(seq, 0xB0, 0x01, 0x9B, 0x92);
+	HK3_SEQ_ADD(seq, 0x92, irc_off ? 0x07 : 0x27);
+}
+
+/*
+ * Operating Mode: NS or HS
+ *
+ * Description: the configs could possibly be overrided by frequency setting,
+ * depending on FI mode.
+ */
+static void hk3_build_op(struct hk3_cmd_seq *seq, bool ns)
+{
+	/* mode set */
+	HK3_SEQ_ADD(seq, 0xF2, 0x01);
+	HK3_SEQ_ADD(seq, 0x60, ns ? 0x18 : 0x00);
+}
+
+/*
+ * Early-exit: enable or disable
+ *
+ * Description: early-exit sequence overrides some configs HBM set. Dimming
+ * commands, which depend on runtime settings, go right before these.
+ */
+static void hk3_build_early_exit(struct hk3_cmd_seq *seq, bool early_exit, bool ns, bool hbm)
+{
+	const u8 val = early_exit ? 0x22 : 0x00;
+
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x10, 0xBD);
+	HK3_SEQ_ADD(seq, 0xBD, val);
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x82, 0xBD);
+	HK3_SEQ_ADD(seq, 0xBD, val, val, val, val);
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, ns ? 0x4E : 0x1E, 0xBD);
+	if (hbm) {
+		if (ns)
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00, 0x02,
+				0x00, 0x04, 0x00, 0x0A, 0x00, 0x16, 0x00, 0x76);
+		else
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00, 0x01,
+				0x00, 0x03, 0x00, 0x0B, 0x00, 0x17, 0x00, 0x77);
+	} else {
+		if (ns)
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00, 0x04,
+				0x00, 0x08, 0x00, 0x14, 0x00, 0x2C, 0x00, 0xEC);
+		else
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, 0x00, 0x02,
+				0x00, 0x06, 0x00, 0x16, 0x00, 0x2E, 0x00, 0xEE);
+	}
+}
 
+/*
+ * Frequency setting: FI, frequency, idle frequency
+ *
+ * Description: this sequence possibly overrides some configs early-exit
+ * and operation set, depending on FI mode.
+ */
+static void hk3_build_frame_auto(struct hk3_cmd_seq *seq, bool ns, bool hbm,
+				 u32 vrefresh, const struct hk3_idle_rate *rate)
+{
+	u8 val;
+
+	if (ns) {
+		/* threshold setting */
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x0C, 0xBD);
+		HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00);
+	} else {
+		/* initial frequency */
+		HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x92, 0xBD);
+		if (vrefresh == 60)
+			val = hbm ? 0x01 : 0x02;
+		else /* 120Hz */
+			val = 0x00;
+		HK3_SEQ_ADD(seq, 0xBD, 0x00, val);
+	}
 	/*
-	 * HBM IRC setting
-	 *
-	 * Description: after EVT1, IRC will be always on. "Flat mode" is used to
-	 * replace IRC on for normal mode and HDR video, and "Flat Z mode" is used
-	 * to replace IRC off for sunlight environment.
+	 * target frequency: idle frame period in 240Hz ticks (120Hz ticks in HBM), less
+	 * 2 ticks for NS and 1 tick for HS, e.g. 0xEE for 1Hz HS
 	 */
-	if (ctx->panel_rev >= PANEL_REV_EVT1) {
-		if (test_bit(FEAT_IRC_Z_MODE, changed_feat)) {
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x02, 0x00, 0x92);
-			if (test_bit(FEAT_IRC_Z_MODE, feat)) {
-				if (spanel->material == MATERIAL_E6) {
-					EXYNOS_DCS_BUF_ADD(ctx, 0x92, 0xBE, 0x98);
-					EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x02, 0xF3, 0x68);
-					EXYNOS_DCS_BUF_ADD(ctx, 0x68, 0x97, 0x87, 0x87, 0xFB, 0xFD, 0xF1);
-				} else {
-					EXYNOS_DCS_BUF_ADD(ctx, 0x92, 0xF1, 0xC1);
-					EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x02, 0xF3, 0x68);
-					EXYNOS_DCS_BUF_ADD(ctx, 0x68, 0x82, 0x70, 0x23, 0x91, 0x88, 0x3C);
-				}
-			} else {
-				EXYNOS_DCS_BUF_ADD(ctx, 0x92, 0x00, 0x00);
-				EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x02, 0xF3, 0x68);
-				if (spanel->material == MATERIAL_E6)
-					EXYNOS_DCS_BUF_ADD(ctx, 0x68, 0x71, 0x81, 0x59, 0x90, 0xA2, 0x80);
-				else
-					EXYNOS_DCS_BUF_ADD(ctx, 0x68, 0x77, 0x81, 0x23, 0x8C, 0x99, 0x3C);
-			}
-		}
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x12, 0xBD);
+	val = (hbm ? 120 : 240) / rate->vrefresh - (ns ? 2 : 1) * (hbm ? 1 : 2);
+	HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x00, val);
+	/* step setting */
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0x9E, 0xBD);
+	if (ns) {
+		if (hbm)
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x02, 0x00, 0x0A, 0x00, 0x00);
+		else
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x04, 0x00, 0x14, 0x00, 0x00);
+	} else {
+		if (hbm)
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x01, 0x00, 0x03, 0x00, 0x0B);
+		else
+			HK3_SEQ_ADD(seq, 0xBD, 0x00, 0x02, 0x00, 0x06, 0x00, 0x16);
+	}
+	HK3_SEQ_ADD(seq, 0xB0, 0x00, 0xAE, 0xBD);
+	val = ns ? 2 : (vrefresh == 60 ? 1 : 0);
+	HK3_SEQ_ADD(seq, 0xBD, rate->path[val][0], rate->path[val][1], rate->path[val][2]);
+	HK3_SEQ_ADD(seq, 0xBD, 0xA3);
+}
+
+static void hk3_build_frame_manual(struct hk3_cmd_seq *seq, bool ns, u32 vrefresh)
+{
+	u8 val;
+
+	HK3_SEQ_ADD(seq, 0xBD, 0x21);
+	if (ns) {
+		if (vrefresh == 1)
+			val = 0x1F;
+		else if (vrefresh == 5)
+			val = 0x1E;
+		else if (vrefresh == 10)
+			val = 0x1B;
+		else if (vrefresh == 30)
+			val = 0x19;
+		else /* 60Hz */
+			val = 0x18;
 	} else {
-		if (test_bit(FEAT_IRC_OFF, changed_feat)) {
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x01, 0x9B, 0x92);
-			val = test_bit(FEAT_IRC_OFF, feat) ? 0x07 : 0x27;
-			EXYNOS_DCS_BUF_ADD(ctx, 0x92, val);
+		if (vrefresh == 1)
+			val = 0x07;
+		else if (vrefresh == 5)
+			val = 0x06;
+		else if (vrefresh == 10)
+			val = 0x03;
+		else if (vrefresh == 30)
+			val = 0x02;
+		else if (vrefresh == 60)
+			val = 0x01;
+		else /* 120Hz */
+			val = 0x00;
+	}
+	HK3_SEQ_ADD(seq, 0x60, val);
+}
+
+VISIBLE_IF_KUNIT void hk3_fill_feat_cmds(struct hk3_feat_cmds *cmds)
+{
+	int a, b, c, d;
+
+	for (a = 0; a < 2; a++) {
+		for (b = 0; b < 2; b++) {
+			hk3_build_te(&cmds->te[a][b], a, b);
+			for (c = 0; c < 2; c++)
+				hk3_build_early_exit(&cmds->early_exit[a][b][c], a, b, c);
+			for (c = 0; c < HK3_AUTO_INIT_FREQ_MAX; c++)
+				for (d = 0; d < HK3_AUTO_IDLE_FREQ_MAX; d++)
+					if (!a || hk3_idle_rates[d].ns)
+						hk3_build_frame_auto(&cmds->frame_auto[a][b][c][d],
+								     a, b, hk3_auto_init_freqs[c],
+								     &hk3_idle_rates[d]);
 		}
+		hk3_build_irc_proto(&cmds->irc[HK3_IRC_PROTO][a], a);
+		hk3_build_irc(&cmds->irc[HK3_IRC_FLAT][a], false, a);
+		hk3_build_irc(&cmds->irc[HK3_IRC_FLAT_E6][a], true, a);
+		hk3_build_op(&cmds->op[a], a);
+		for (b = 0; b < HK3_MANUAL_FREQ_MAX; b++)
+			hk3_build_frame_manual(&cmds->frame_manual[a][b], a, hk3_manual_freqs[b]);
 	}
+}
+EXPORT_SYMBOL_IF_KUNIT(hk3_fill_feat_cmds);
 
-	/*
-	 * Operating Mode: NS or HS
-	 *
-	 * Description: the configs could possibly be overrided by frequency setting,
-	 * depending on FI mode.
-	 */
-	if (test_bit(FEAT_OP_NS, changed_feat)) {
-		/* mode set */
-		EXYNOS_DCS_BUF_ADD(ctx, 0xF2, 0x01);
-		val = test_bit(FEAT_OP_NS, feat) ? 0x18 : 0x00;
-		EXYNOS_DCS_BUF_ADD(ctx, 0x60, val);
+static struct hk3_feat_cmds *hk3_build_feat_cmds(struct device *dev)
+{
+	struct hk3_feat_cmds *cmds;
+
+	cmds = devm_kzalloc(dev, sizeof(*cmds), GFP_KERNEL);
+	if (cmds)
+		hk3_fill_feat_cmds(cmds);
+
+	return cmds;
+}
+
+/* index of @freq in @freqs, or @fallback with a warning if it's not supported */
+static int hk3_get_freq_idx(struct exynos_panel *ctx, const char *what, u32 freq,
+			    const u32 *freqs, int num, int fallback, bool ns)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		if (freqs[i] == freq)
+			return i;
+
+	dev_warn(ctx->dev, "%s: unsupported %s %d (%s)\n", __func__, what, freq,
+		 ns ? "ns" : "hs");
+
+	return fallback;
+}
+
+/*
+ * index of @idle_vrefresh in hk3_idle_rates, or with a warning of the next higher rate
+ * supported in the operating mode if it's not supported
+ */
+static int hk3_get_idle_rate_idx(struct exynos_panel *ctx, u32 idle_vrefresh, bool ns)
+{
+	/* the highest rate is supported in both operating modes */
+	int i, fallback = HK3_AUTO_IDLE_FREQ_MAX - 1;
+
+	for (i = HK3_AUTO_IDLE_FREQ_MAX - 1; i >= 0; i--) {
+		const struct hk3_idle_rate *rate = &hk3_idle_rates[i];
+
+		if (ns && !rate->ns)
+			continue;
+		if (rate->vrefresh == idle_vrefresh)
+			return i;
+		if (rate->vrefresh > idle_vrefresh)
+			fallback = i;
 	}
 
-	/*
-	 * Note: the following command sequence should be sent as a whole if one of panel
-	 * state defined by enum panel_state changes or at turning on panel, or unexpected
-	 * behaviors will be seen, e.g. black screen, flicker.
-	 */
+	dev_warn(ctx->dev, "%s: unsupported target freq %d (%s), use %d\n", __func__,
+		 idle_vrefresh, ns ? "ns" : "hs", hk3_idle_rates[fallback].vrefresh);
 
-	/*
-	 * Early-exit: enable or disable
-	 *
-	 * Description: early-exit sequence overrides some configs HBM set.
-	 */
-	if (is_panel_enabled(ctx) && !ctx->current_mode->exynos_mode.is_lp_mode)
-		hk3_set_override_dimming(ctx, feat, false);
-	else
-		hk3_set_default_dimming(ctx, feat, false);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x10, 0xBD);
-	val = test_bit(FEAT_EARLY_EXIT, feat) ? 0x22 : 0x00;
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, val);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x82, 0xBD);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, val, val, val, val);
-	val = test_bit(FEAT_OP_NS, feat) ? 0x4E : 0x1E;
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, val, 0xBD);
-	if (test_bit(FEAT_HBM, feat)) {
-		if (test_bit(FEAT_OP_NS, feat))
-			EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00, 0x00, 0x02,
-				0x00, 0x04, 0x00, 0x0A, 0x00, 0x16, 0x00, 0x76);
-		else
-			EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00, 0x00, 0x01,
-				0x00, 0x03, 0x00, 0x0B, 0x00, 0x17, 0x00, 0x77);
+	return fallback;
+}
+
+/* build @plan updating the panel to @feat, @vrefresh and @idle_vrefresh from its state now */
+static void hk3_build_feat_plan(struct exynos_panel *ctx, struct hk3_feat_plan *plan,
+				const u32 vrefresh, const u32 idle_vrefresh,
+				const unsigned long *feat, bool enforce)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const struct hk3_feat_cmds *cmds = spanel->feat_cmds;
+	const struct hk3_variant *variant = &spanel->variant;
+	const bool ns = test_bit(FEAT_OP_NS, feat);
+	const bool hbm = test_bit(FEAT_HBM, feat);
+	const u8 *cmd;
+
+	memset(plan, 0, sizeof(*plan));
+	plan->valid = true;
+	plan->hw_seq = spanel->hw_feat_seq;
+	bitmap_copy(plan->feat, feat, FEAT_MAX);
+	plan->vrefresh = vrefresh;
+	plan->idle_vrefresh = idle_vrefresh;
+	plan->override = is_panel_enabled(ctx) && !ctx->current_mode->exynos_mode.is_lp_mode;
+	plan->brightness = spanel->requested_brightness;
+	plan->profile_seq = READ_ONCE(spanel->dimming_profile_seq);
+	plan->force_changeable_te = spanel->force_changeable_te;
+	bitmap_copy(plan->hw_feat, spanel->hw_feat, FEAT_MAX);
+	plan->hw_vrefresh = spanel->hw_vrefresh;
+	plan->hw_idle_vrefresh = spanel->hw_idle_vrefresh;
+	plan->hw_early_exit_seq = spanel->hw_early_exit_seq;
+	plan->hw_frame_seq = spanel->hw_frame_seq;
+	memcpy(plan->hw_dimming_cmd, spanel->hw_dimming_cmd, HK3_DIMMING_CMD_LEN);
+
+	if (enforce) {
+		bitmap_fill(plan->changed_feat, FEAT_MAX);
+		plan->hw_early_exit_seq = NULL;
+		plan->hw_frame_seq = NULL;
 	} else {
-		if (test_bit(FEAT_OP_NS, feat))
-			EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00, 0x00, 0x04,
-				0x00, 0x08, 0x00, 0x14, 0x00, 0x2C, 0x00, 0xEC);
-		else
-			EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00, 0x00, 0x02,
-				0x00, 0x06, 0x00, 0x16, 0x00, 0x2E, 0x00, 0xEE);
+		bitmap_xor(plan->changed_feat, feat, spanel->hw_feat, FEAT_MAX);
+		if (bitmap_empty(plan->changed_feat, FEAT_MAX) &&
+			vrefresh == spanel->hw_vrefresh &&
+			idle_vrefresh == spanel->hw_idle_vrefresh) {
+			plan->skip = true;
+			return;
+		}
+	}
+
+	/* TE setting */
+	if (test_bit(FEAT_EARLY_EXIT, plan->changed_feat) ||
+		test_bit(FEAT_OP_NS, plan->changed_feat)) {
+		const bool fixed = test_bit(FEAT_EARLY_EXIT, feat) && !spanel->force_changeable_te;
+
+		plan->te = &cmds->te[fixed][ns];
 	}
 
+	/* HBM IRC setting */
+	if (test_bit(variant->rev->irc_feat, plan->changed_feat))
+		plan->irc = &variant->irc[test_bit(variant->rev->irc_feat, feat)];
+
+	/* Operating Mode: NS or HS */
+	if (test_bit(FEAT_OP_NS, plan->changed_feat))
+		plan->op = &cmds->op[ns];
+
 	/*
-	 * Frequency setting: FI, frequency, idle frequency
+	 * Note: the following command sequence should be sent as a whole if one of panel
+	 * state defined by enum panel_state changes or at turning on panel, or unexpected
+	 * behaviors will be seen, e.g. black screen, flicker.
 	 *
-	 * Description: this sequence possibly overrides some configs early-exit
-	 * and operation set, depending on FI mode.
+	 * Each block is looked up by the inputs it depends on, so comparing with the one
+	 * sent last time tells whether it's dirty. Whenever early-exit is dirty, the whole
+	 * sequence is sent. Otherwise dimming and frequency setting are sent on their own
+	 * only if they change, e.g. an idle rate change only sends frequency setting.
 	 */
+	plan->early_exit = &cmds->early_exit[test_bit(FEAT_EARLY_EXIT, feat)][ns][hbm];
+	plan->send_early_exit = plan->early_exit != plan->hw_early_exit_seq;
+
+	/* Dimming */
+	rcu_read_lock();
+	cmd = hk3_get_dimming_cmd(ctx, feat, vrefresh, plan->override);
+	memcpy(plan->dimming_cmd, cmd, HK3_DIMMING_CMD_LEN);
+	rcu_read_unlock();
+	plan->send_dimming = plan->send_early_exit ||
+		memcmp(plan->dimming_cmd, spanel->hw_dimming_cmd, HK3_DIMMING_CMD_LEN);
+
+	/* Frequency setting: FI, frequency, idle frequency */
 	if (test_bit(FEAT_FRAME_AUTO, feat)) {
-		if (test_bit(FEAT_OP_NS, feat)) {
-			/* threshold setting */
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x0C, 0xBD);
-			EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00);
-		} else {
-			/* initial frequency */
-			EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x92, 0xBD);
-			if (vrefresh == 60) {
-				val = test_bit(FEAT_HBM, feat) ? 0x01 : 0x02;
-			} else {
-				if (vrefresh != 120)
-					dev_warn(ctx->dev, "%s: unsupported init freq %d (hs)\n",
-						 __func__, vrefresh);
-				/* 120Hz */
-				val = 0x00;
-			}
-			EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, val);
-		}
-		/* target frequency */
-		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x12, 0xBD);
-		if (test_bit(FEAT_OP_NS, feat)) {
-			if (idle_vrefresh == 30) {
-				val = test_bit(FEAT_HBM, feat) ? 0x02 : 0x04;
-			} else if (idle_vrefresh == 10) {
-				val = test_bit(FEAT_HBM, feat) ? 0x0A : 0x14;
-			} else {
-				if (idle_vrefresh != 1)
-					dev_warn(ctx->dev, "%s: unsupported target freq %d (ns)\n",
-						 __func__, idle_vrefresh);
-				/* 1Hz */
-				val = test_bit(FEAT_HBM, feat) ? 0x76 : 0xEC;
-			}
-			EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00, val);
-		} else {
-			if (idle_vrefresh == 30) {
-				val = test_bit(FEAT_HBM, feat) ? 0x03 : 0x06;
-			} else if (idle_vrefresh == 10) {
-				val = test_bit(FEAT_HBM, feat) ? 0x0B : 0x16;
-			} else {
-				if (idle_vrefresh != 1)
-					dev_warn(ctx->dev, "%s: unsupported target freq %d (hs)\n",
-						 __func__, idle_vrefresh);
-				/* 1Hz */
-				val = test_bit(FEAT_HBM, feat) ? 0x77 : 0xEE;
-			}
-			EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00, val);
-		}
-		/* step setting */
-		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x9E, 0xBD);
-		if (test_bit(FEAT_OP_NS, feat)) {
-			if (test_bit(FEAT_HBM, feat))
-				EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x02, 0x00, 0x0A, 0x00, 0x00);
-			else
-				EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x04, 0x00, 0x14, 0x00, 0x00);
-		} else {
-			if (test_bit(FEAT_HBM, feat))
-				EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x01, 0x00, 0x03, 0x00, 0x0B);
-			else
-				EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x02, 0x00, 0x06, 0x00, 0x16);
-		}
-		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0xAE, 0xBD);
-		if (test_bit(FEAT_OP_NS, feat)) {
-			if (idle_vrefresh == 30) {
-				/* 60Hz -> 30Hz idle */
-				EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00, 0x00);
-			} else if (idle_vrefresh == 10) {
-				/* 60Hz -> 10Hz idle */
-				EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x01, 0x00, 0x00);
-			} else {
-				if (idle_vrefresh != 1)
-					dev_warn(ctx->dev, "%s: unsupported freq step to %d (ns)\n",
-						 __func__, idle_vrefresh);
-				/* 60Hz -> 1Hz idle */
-				EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x01, 0x03, 0x00);
-			}
-		} else {
-			if (vrefresh == 60) {
-				if (idle_vrefresh == 30) {
-					/* 60Hz -> 30Hz idle */
-					EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x01, 0x00, 0x00);
-				} else if (idle_vrefresh == 10) {
-					/* 60Hz -> 10Hz idle */
-					EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x01, 0x01, 0x00);
-				} else {
-					if (idle_vrefresh != 1)
-						dev_warn(ctx->dev, "%s: unsupported freq step to %d (hs)\n",
-							 __func__, vrefresh);
-					/* 60Hz -> 1Hz idle */
-					EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x01, 0x01, 0x03);
-				}
-			} else {
-				if (vrefresh != 120)
-					dev_warn(ctx->dev, "%s: unsupported freq step from %d (hs)\n",
-						 __func__, vrefresh);
-				if (idle_vrefresh == 30) {
-					/* 120Hz -> 30Hz idle */
-					EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x00, 0x00);
-				} else if (idle_vrefresh == 10) {
-					/* 120Hz -> 10Hz idle */
-					EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x03, 0x00);
-				} else {
-					if (idle_vrefresh != 1)
-						dev_warn(ctx->dev, "%s: unsupported freq step to %d (hs)\n",
-						 __func__, idle_vrefresh);
-					/* 120Hz -> 1Hz idle */
-					EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x01, 0x03);
-				}
-			}
-		}
-		EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0xA3);
+		/* NS doesn't set initial frequency */
+		const int init = ns ? 0 :
+			hk3_get_freq_idx(ctx, "init freq", vrefresh, hk3_auto_init_freqs,
+					 HK3_AUTO_INIT_FREQ_MAX, HK3_AUTO_INIT_FREQ_MAX - 1, ns);
+		const int idle = hk3_get_idle_rate_idx(ctx, idle_vrefresh, ns);
+
+		plan->frame = &cmds->frame_auto[ns][hbm][init][idle];
 	} else { /* manual */
-		EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x21);
-		if (test_bit(FEAT_OP_NS, feat)) {
-			if (vrefresh == 1) {
-				val = 0x1F;
-			} else if (vrefresh == 5) {
-				val = 0x1E;
-			} else if (vrefresh == 10) {
-				val = 0x1B;
-			} else if (vrefresh == 30) {
-				val = 0x19;
-			} else {
-				if (vrefresh != 60)
-					dev_warn(ctx->dev,
-						 "%s: unsupported manual freq %d (ns)\n",
-						 __func__, vrefresh);
-				/* 60Hz */
-				val = 0x18;
-			}
-		} else {
-			if (vrefresh == 1) {
-				val = 0x07;
-			} else if (vrefresh == 5) {
-				val = 0x06;
-			} else if (vrefresh == 10) {
-				val = 0x03;
-			} else if (vrefresh == 30) {
-				val = 0x02;
-			} else if (vrefresh == 60) {
-				val = 0x01;
-			} else {
-				if (vrefresh != 120)
-					dev_warn(ctx->dev,
-						 "%s: unsupported manual freq %d (hs)\n",
-						 __func__, vrefresh);
-				/* 120Hz */
-				val = 0x00;
-			}
-		}
-		EXYNOS_DCS_BUF_ADD(ctx, 0x60, val);
+		/* 120Hz is HS only */
+		const int num = ns ? HK3_MANUAL_FREQ_MAX - 1 : HK3_MANUAL_FREQ_MAX;
+		const int idx = hk3_get_freq_idx(ctx, "manual freq", vrefresh, hk3_manual_freqs,
+						 num, num - 1, ns);
+
+		plan->frame = &cmds->frame_manual[ns][idx];
+	}
+	plan->send_frame = plan->send_early_exit || plan->frame != plan->hw_frame_seq;
+}
+
+/* whether @plan is built for the request and still applies on the panel state now */
+static bool hk3_feat_plan_matches(struct exynos_panel *ctx, const struct hk3_feat_plan *plan,
+				  const u32 vrefresh, const u32 idle_vrefresh,
+				  const unsigned long *feat)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	/* the sequence tells a plan built on an older panel state at once */
+	return plan->valid &&
+		plan->hw_seq == spanel->hw_feat_seq &&
+		plan->vrefresh == vrefresh &&
+		plan->idle_vrefresh == idle_vrefresh &&
+		bitmap_equal(plan->feat, feat, FEAT_MAX) &&
+		plan->override == (is_panel_enabled(ctx) &&
+				   !ctx->current_mode->exynos_mode.is_lp_mode) &&
+		plan->brightness == spanel->requested_brightness &&
+		plan->profile_seq == READ_ONCE(spanel->dimming_profile_seq) &&
+		plan->force_changeable_te == spanel->force_changeable_te &&
+		bitmap_equal(plan->hw_feat, spanel->hw_feat, FEAT_MAX) &&
+		plan->hw_vrefresh == spanel->hw_vrefresh &&
+		plan->hw_idle_vrefresh == spanel->hw_idle_vrefresh &&
+		plan->hw_early_exit_seq == spanel->hw_early_exit_seq &&
+		plan->hw_frame_seq == spanel->hw_frame_seq &&
+		!memcmp(plan->hw_dimming_cmd, spanel->hw_dimming_cmd, HK3_DIMMING_CMD_LEN);
+}
+
+static void hk3_send_feat_plan(struct exynos_panel *ctx, const struct hk3_feat_plan *plan)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const struct hk3_variant *variant = &spanel->variant;
+	const unsigned long *feat = plan->feat;
+
+	if (plan->skip) {
+		dev_dbg(ctx->dev, "%s: no changes, skip update\n", __func__);
+		return;
 	}
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);;
+	spanel->hw_feat_seq++;
+	spanel->hw_vrefresh = plan->vrefresh;
+	spanel->hw_idle_vrefresh = plan->idle_vrefresh;
+	bitmap_copy(spanel->hw_feat, feat, FEAT_MAX);
+	dev_dbg(ctx->dev,
+		"op=%s ee=%s hbm=%s irc=%s fi=%s fps=%u idle_fps=%u\n",
+		test_bit(FEAT_OP_NS, feat) ? "ns" : "hs",
+		test_bit(FEAT_EARLY_EXIT, feat) ? "on" : "off",
+		test_bit(FEAT_HBM, feat) ? "on" : "off",
+		variant->rev->irc_names[test_bit(variant->rev->irc_feat, feat)],
+		test_bit(FEAT_FRAME_AUTO, feat) ? "auto" : "manual",
+		plan->vrefresh,
+		plan->idle_vrefresh);
+
+	hk3_key_get(ctx);
+
+	if (plan->te)
+		hk3_seq_buf_add(ctx, plan->te);
+
+	/* TE2 setting */
+	if (test_bit(FEAT_OP_NS, plan->changed_feat))
+		hk3_update_te2(ctx);
+
+	if (plan->irc)
+		hk3_seq_buf_add(ctx, plan->irc);
+
+	if (plan->op) {
+		hk3_seq_buf_add(ctx, plan->op);
+		/* accounted once latched, see hk3_commit_done() */
+		spanel->op_hz_sent = spanel->op_hz_ts != 0;
+	}
+
+	memcpy(spanel->hw_dimming_cmd, plan->dimming_cmd, HK3_DIMMING_CMD_LEN);
+	if (plan->send_dimming)
+		hk3_queue_dimming_freq_cmd(ctx);
+
+	if (plan->send_early_exit)
+		hk3_seq_buf_add(ctx, plan->early_exit);
+	spanel->hw_early_exit_seq = plan->early_exit;
+
+	if (plan->send_frame)
+		hk3_seq_buf_add(ctx, plan->frame);
+	spanel->hw_frame_seq = plan->frame;
+
+	HK3_DCS_BUF_ADD_SET(ctx, freq_update);
+	hk3_key_put(ctx, true);
+}
+
+static void hk3_set_panel_feat(struct exynos_panel *ctx, const u32 vrefresh,
+	const u32 idle_vrefresh, const unsigned long *feat, bool enforce)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	struct hk3_feat_plan *next = &spanel->next_plan;
+	struct hk3_feat_plan plan;
+
+	if (!enforce && hk3_feat_plan_matches(ctx, next, vrefresh, idle_vrefresh, feat)) {
+		spanel->next_plan_hits++;
+		hk3_send_feat_plan(ctx, next);
+	} else {
+		if (next->valid)
+			spanel->next_plan_misses++;
+		hk3_build_feat_plan(ctx, &plan, vrefresh, idle_vrefresh, feat, enforce);
+		hk3_send_feat_plan(ctx, &plan);
+	}
+	/* panel state is changed, or the plan is used */
+	next->valid = false;
+}
+
+static u8 hk3_get_wrctrld(struct exynos_panel *ctx)
+{
+	u8 val = HK3_WRCTRLD_BCTRL_BIT;
+
+	if (IS_HBM_ON(ctx->hbm_mode))
+		val |= HK3_WRCTRLD_HBM_BIT;
+
+	if (ctx->hbm.local_hbm.enabled)
+		val |= HK3_WRCTRLD_LOCAL_HBM_BIT;
+
+	if (ctx->dimming_on)
+		val |= HK3_WRCTRLD_DIMMING_BIT;
+
+	dev_dbg(ctx->dev,
+		"%s(wrctrld:0x%x, hbm: %s, dimming: %s local_hbm: %s)\n",
+		__func__, val, IS_HBM_ON(ctx->hbm_mode) ? "on" : "off",
+		ctx->dimming_on ? "on" : "off",
+		ctx->hbm.local_hbm.enabled ? "on" : "off");
+
+	return val;
+}
+
+static void hk3_write_display_mode(struct exynos_panel *ctx,
+				   const struct drm_display_mode *mode)
+{
+	HK3_DCS_BUF_ADD_AND_FLUSH(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY, hk3_get_wrctrld(ctx));
 }
 
 /**
@@ -1009,9 +1882,32 @@ static void hk3_update_panel_feat(struct exynos_panel *ctx, u32 vrefresh, bool e
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
 
+	/*
+	 * features marked in this commit are sent here as well, and display mode has to go
+	 * first if leaving HBM, see hk3_txn_commit()
+	 */
+	if ((spanel->txn_dirty & HK3_TXN_WRCTRLD) && !IS_HBM_ON(ctx->hbm_mode)) {
+		hk3_write_display_mode(ctx, &ctx->current_mode->mode);
+		spanel->txn_dirty &= ~HK3_TXN_WRCTRLD;
+	}
+	spanel->txn_dirty &= ~HK3_TXN_FEAT;
 	hk3_set_panel_feat(ctx, vrefresh, spanel->auto_mode_vrefresh, spanel->feat, enforce);
 }
 
+/* features of refresh mode at @vrefresh, auto frame insertion if @idle_vrefresh is set */
+static void hk3_set_refresh_mode_feat(unsigned long *feat, u32 vrefresh, u32 idle_vrefresh)
+{
+	if (idle_vrefresh)
+		set_bit(FEAT_FRAME_AUTO, feat);
+	else
+		clear_bit(FEAT_FRAME_AUTO, feat);
+
+	if (vrefresh == 120 || idle_vrefresh)
+		set_bit(FEAT_EARLY_EXIT, feat);
+	else
+		clear_bit(FEAT_EARLY_EXIT, feat);
+}
+
 static void hk3_update_refresh_mode(struct exynos_panel *ctx,
 					const struct exynos_panel_mode *pmode,
 					const u32 idle_vrefresh)
@@ -1034,16 +1930,7 @@ static void hk3_update_refresh_mode(struct exynos_panel *ctx,
 	dev_dbg(ctx->dev, "%s: mode: %s set idle_vrefresh: %u\n", __func__,
 		pmode->mode.name, idle_vrefresh);
 
-	if (idle_vrefresh)
-		set_bit(FEAT_FRAME_AUTO, spanel->feat);
-	else
-		clear_bit(FEAT_FRAME_AUTO, spanel->feat);
-
-	if (vrefresh == 120 || idle_vrefresh)
-		set_bit(FEAT_EARLY_EXIT, spanel->feat);
-	else
-		clear_bit(FEAT_EARLY_EXIT, spanel->feat);
-
+	hk3_set_refresh_mode_feat(spanel->feat, vrefresh, idle_vrefresh);
 	spanel->auto_mode_vrefresh = idle_vrefresh;
 	/*
 	 * Note: when mode is explicitly set, panel performs early exit to get out
@@ -1123,27 +2010,61 @@ static void hk3_wait_one_vblank(struct exynos_panel *ctx)
 	DPU_ATRACE_END(__func__);
 }
 
+/*
+ * Queue @item to be sent in an idle window, half a frame after now so it's clear of the
+ * commands of both this frame and the next one.
+ */
+static void hk3_lowprio_queue(struct exynos_panel *ctx, enum hk3_lowprio_item item)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	struct hk3_lowprio *q = &spanel->lowprio;
+
+	if (!test_and_set_bit(item, &q->pending))
+		q->queued_ts[item] = ktime_get();
+
+	schedule_delayed_work(&q->work,
+		usecs_to_jiffies(EXYNOS_VREFRESH_TO_PERIOD_USEC(spanel->hw_vrefresh) / 2));
+}
+
+/* drain the queue right away, e.g. panel is idle after entering self refresh */
+static void hk3_lowprio_kick(struct exynos_panel *ctx)
+{
+	struct hk3_lowprio *q = &to_spanel(ctx)->lowprio;
+
+	if (READ_ONCE(q->pending))
+		mod_delayed_work(system_wq, &q->work, 0);
+}
+
+/* read @reads in an F0 key scope, commands queued in the session are flushed first */
+static int hk3_read_batch(struct exynos_panel *ctx, struct panel_read *reads, size_t n)
+{
+	int ret;
+
+	hk3_key_get(ctx);
+	ret = panel_read_batch(ctx, reads, n);
+	hk3_key_put(ctx, true);
+
+	return ret;
+}
+
 static void hk3_read_back_vreg(struct exynos_panel *ctx)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
-	char buf[HK3_VREG_PARAM_NUM] = {0};
+	u8 buf[HK3_VREG_PARAM_NUM] = {0};
+	struct panel_read read = PANEL_READ(0x0031, 0xF4, buf, HK3_VREG_PARAM_NUM);
 	int ret;
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xB0, 0x00, 0x31, 0xF4);
-	ret = mipi_dsi_dcs_read(dsi, 0xF4, buf, HK3_VREG_PARAM_NUM);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
-	if (ret != HK3_VREG_PARAM_NUM) {
+	ret = hk3_read_batch(ctx, &read, 1);
+	if (ret) {
 		dev_warn(ctx->dev, "unable to read vreg setting (%d)\n", ret);
 	} else {
 		exynos_bin2hex(buf, HK3_VREG_PARAM_NUM,
 			       spanel->hw_vreg, sizeof(spanel->hw_vreg));
-		if (!strcmp(spanel->hw_vreg, HK3_VREG_STR(ctx)))
+		if (!strcmp(spanel->hw_vreg, spanel->variant.rev->vreg))
 			dev_dbg(ctx->dev, "normal vreg: %s\n", spanel->hw_vreg);
 		else
 			dev_warn(ctx->dev, "abnormal vreg: %s (expect %s)\n",
-				 spanel->hw_vreg, HK3_VREG_STR(ctx));
+				 spanel->hw_vreg, spanel->variant.rev->vreg);
 	}
 
 	spanel->read_vreg = false;
@@ -1160,8 +2081,11 @@ static bool hk3_set_self_refresh(struct exynos_panel *ctx, bool enable)
 	if (unlikely(!pmode))
 		return false;
 
-	if (enable && spanel->read_vreg)
-		hk3_read_back_vreg(ctx);
+	if (enable) {
+		if (spanel->read_vreg)
+			hk3_lowprio_queue(ctx, HK3_LOWPRIO_VREG);
+		hk3_lowprio_kick(ctx);
+	}
 
 	/* self refresh is not supported in lp mode since that always makes use of early exit */
 	if (pmode->exynos_mode.is_lp_mode) {
@@ -1171,9 +2095,6 @@ static bool hk3_set_self_refresh(struct exynos_panel *ctx, bool enable)
 		return false;
 	}
 
-	if (spanel->pending_temp_update && enable)
-		hk3_update_disp_therm(ctx);
-
 	idle_vrefresh = hk3_get_min_idle_vrefresh(ctx, pmode);
 
 	if (pmode->idle_mode != IDLE_MODE_ON_SELF_REFRESH) {
@@ -1254,7 +2175,9 @@ static int hk3_atomic_check(struct exynos_panel *ctx, struct drm_atomic_state *s
 	struct drm_crtc_state *old_crtc_state, *new_crtc_state;
 	struct hk3_panel *spanel = to_spanel(ctx);
 
-	hk3_update_lhbm_hist_config(ctx);
+	/* not needed until LHBM is used, the flag is only tested here */
+	if (!spanel->lhbm_ctl.hist_roi_configured)
+		hk3_lowprio_queue(ctx, HK3_LOWPRIO_HIST);
 
 	if (!ctx->current_mode || drm_mode_vrefresh(&ctx->current_mode->mode) == 120 ||
 	    !new_conn_state || !new_conn_state->crtc)
@@ -1290,47 +2213,21 @@ static int hk3_atomic_check(struct exynos_panel *ctx, struct drm_atomic_state *s
 	return 0;
 }
 
-static void hk3_write_display_mode(struct exynos_panel *ctx,
-				   const struct drm_display_mode *mode)
-{
-	u8 val = HK3_WRCTRLD_BCTRL_BIT;
-
-	if (IS_HBM_ON(ctx->hbm_mode))
-		val |= HK3_WRCTRLD_HBM_BIT;
-
-	if (ctx->hbm.local_hbm.enabled)
-		val |= HK3_WRCTRLD_LOCAL_HBM_BIT;
-
-	if (ctx->dimming_on)
-		val |= HK3_WRCTRLD_DIMMING_BIT;
-
-	dev_dbg(ctx->dev,
-		"%s(wrctrld:0x%x, hbm: %s, dimming: %s local_hbm: %s)\n",
-		__func__, val, IS_HBM_ON(ctx->hbm_mode) ? "on" : "off",
-		ctx->dimming_on ? "on" : "off",
-		ctx->hbm.local_hbm.enabled ? "on" : "off");
-
-	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY, val);
-}
-
 #define HK3_OPR_VAL_LEN 2
 #define HK3_MAX_OPR_VAL 0x3FF
 /* Get OPR (on pixel ratio), the unit is percent */
 static int hk3_get_opr(struct exynos_panel *ctx, u8 *opr)
 {
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
 	u8 buf[HK3_OPR_VAL_LEN] = {0};
+	struct panel_read read = PANEL_READ(0x00E7, 0x91, buf, HK3_OPR_VAL_LEN);
 	u16 val;
 	int ret;
 
 	DPU_ATRACE_BEGIN(__func__);
-	EXYNOS_DCS_WRITE_TABLE(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_WRITE_SEQ(ctx, 0xB0, 0x00, 0xE7, 0x91);
-	ret = mipi_dsi_dcs_read(dsi, 0x91, buf, HK3_OPR_VAL_LEN);
-	EXYNOS_DCS_WRITE_TABLE(ctx, lock_cmd_f0);
+	ret = hk3_read_batch(ctx, &read, 1);
 	DPU_ATRACE_END(__func__);
 
-	if (ret != HK3_OPR_VAL_LEN) {
+	if (ret) {
 		dev_warn(ctx->dev, "Failed to read OPR (%d)\n", ret);
 		return ret;
 	}
@@ -1343,107 +2240,269 @@ static int hk3_get_opr(struct exynos_panel *ctx, u8 *opr)
 }
 
 #define HK3_ZA_THRESHOLD_OPR 80
-static void hk3_update_za(struct exynos_panel *ctx)
+/*
+ * Get whether za is to be enabled from the ACL setting. Return false if that's up to OPR,
+ * which has to be read from panel.
+ */
+static bool hk3_get_za_state(struct exynos_panel *ctx, bool *enable)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
-	bool enable_za = false;
+
+	*enable = false;
+	if (!spanel->hw_acl_setting || spanel->force_za_off)
+		return true;
+	if (spanel->variant.rev->za_by_opr)
+		return false;
+
+	*enable = true;
+	return true;
+}
+
+/* queue za setting if it's changed, sent along with the enclosing F0 key scope */
+static void hk3_set_za(struct exynos_panel *ctx, bool enable)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	if (spanel->hw_za_enabled == enable)
+		return;
+
+	hk3_key_get(ctx);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x01, 0x6C, 0x92);
+	HK3_DCS_BUF_ADD(ctx, 0x92, enable ? spanel->variant.rev->za_val : 0x00);
+	hk3_key_put(ctx, true);
+
+	spanel->hw_za_enabled = enable;
+	dev_info(ctx->dev, "%s: %s\n", __func__, enable ? "on" : "off");
+}
+
+static void hk3_update_za(struct exynos_panel *ctx)
+{
+	bool enable_za;
 	u8 opr;
 
-	if ((spanel->hw_acl_setting > 0) && !spanel->force_za_off) {
-		if (ctx->panel_rev != PANEL_REV_PROTO1) {
-			enable_za = true;
-		} else if (!hk3_get_opr(ctx, &opr)) {
-			enable_za = (opr > HK3_ZA_THRESHOLD_OPR);
-		} else {
+	if (!hk3_get_za_state(ctx, &enable_za)) {
+		if (hk3_get_opr(ctx, &opr)) {
 			dev_warn(ctx->dev, "Unable to update za\n");
 			return;
 		}
+		enable_za = (opr > HK3_ZA_THRESHOLD_OPR);
 	}
 
-	if (spanel->hw_za_enabled != enable_za) {
-		/* LP setting - 0x21 or 0x11: 7.5%, 0x00: off */
-		u8 val = 0;
+	hk3_set_za(ctx, enable_za);
+}
 
-		EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x01, 0x6C, 0x92);
-		if (enable_za)
-			val = (ctx->panel_rev == PANEL_REV_PROTO1) ? 0x21 : 0x11;
-		EXYNOS_DCS_BUF_ADD(ctx, 0x92, val);
-		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+/*
+ * Sync za in the current F0 key scope, so it's sent in the same flush as the ACL change
+ * queued before. It costs nothing unless za is changed. Only if za is up to OPR, the OPR
+ * read is left to the low priority queue.
+ */
+static void hk3_sync_za(struct exynos_panel *ctx)
+{
+	bool enable_za;
 
-		spanel->hw_za_enabled = enable_za;
-		dev_info(ctx->dev, "%s: %s\n", __func__, enable_za ? "on" : "off");
-	}
+	if (hk3_get_za_state(ctx, &enable_za))
+		hk3_set_za(ctx, enable_za);
+	else
+		hk3_lowprio_queue(ctx, HK3_LOWPRIO_ZA);
 }
 
-#define HK3_ACL_ZA_THRESHOLD_DBV_P1_0 3917
-#define HK3_ACL_ZA_THRESHOLD_DBV_P1_1 3781
-#define HK3_ACL_ENHANCED_THRESHOLD_DBV 3865
-#define HK3_ACL_NORMAL_THRESHOLD_DBV_1 3570
-#define HK3_ACL_NORMAL_THRESHOLD_DBV_2 3963
+static const struct hk3_lowprio_desc {
+	const char *name;
+	/* only sent in normal mode, kept pending otherwise */
+	bool normal_only;
+	void (*run)(struct exynos_panel *ctx);
+} hk3_lowprio_descs[HK3_LOWPRIO_MAX] = {
+	[HK3_LOWPRIO_THERM] = { "therm", true, hk3_update_disp_therm },
+	[HK3_LOWPRIO_ZA] = { "za", true, hk3_update_za },
+	[HK3_LOWPRIO_VREG] = { "vreg", false, hk3_read_back_vreg },
+	[HK3_LOWPRIO_HIST] = { "hist", false, hk3_update_lhbm_hist_config },
+};
 
-/* updated za when acl mode changed */
-static void hk3_set_acl_mode(struct exynos_panel *ctx, enum exynos_acl_mode mode)
+static void hk3_lowprio_account(struct hk3_lowprio *q, enum hk3_lowprio_item item)
+{
+	const s64 delay_us = ktime_us_delta(ktime_get(), q->queued_ts[item]);
+	u32 bucket = 0;
+
+	while (bucket < HK3_LOWPRIO_DELAY_BUCKETS - 1 && delay_us >= (USEC_PER_MSEC << bucket))
+		bucket++;
+	q->delay_hist[bucket]++;
+	if (delay_us > q->max_delay_us)
+		q->max_delay_us = delay_us;
+}
+
+static void hk3_lowprio_work(struct work_struct *work)
+{
+	struct hk3_panel *spanel = container_of(to_delayed_work(work), struct hk3_panel,
+						lowprio.work);
+	struct exynos_panel *ctx = &spanel->base;
+	struct hk3_lowprio *q = &spanel->lowprio;
+	bool normal;
+	int i;
+
+	mutex_lock(&ctx->mode_lock);
+	if (!is_panel_active(ctx) || !ctx->current_mode)
+		goto out;
+
+	normal = !ctx->current_mode->exynos_mode.is_lp_mode;
+	DPU_ATRACE_BEGIN(__func__);
+	/* items share one F0 key scope */
+	hk3_key_begin(ctx);
+	for (i = 0; i < HK3_LOWPRIO_MAX; i++) {
+		if (hk3_lowprio_descs[i].normal_only && !normal)
+			continue;
+		if (!test_and_clear_bit(i, &q->pending))
+			continue;
+		hk3_lowprio_account(q, i);
+		hk3_lowprio_descs[i].run(ctx);
+	}
+	hk3_key_put(ctx, true);
+	DPU_ATRACE_END(__func__);
+out:
+	mutex_unlock(&ctx->mode_lock);
+}
+
+/*
+ * Queue ACL setting for @mode, to be flushed by the caller. Return whether it's changed,
+ * in which case za needs to be updated.
+ */
+static bool hk3_update_acl(struct exynos_panel *ctx, enum exynos_acl_mode mode)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
-	u16 dbv_th = 0;
+	const struct hk3_rev_variant *v = spanel->variant.rev;
+	const struct hk3_acl_level *levels =
+		(mode == ACL_ENHANCED) ? v->acl_enhanced : v->acl_normal;
 	u8 setting = 0;
-	bool enable_acl = false;
-	/*
-	 * ACL mode and setting:
-	 *
-	 * P1.0
-	 *    NORMAL/ENHANCED- 5% (0x01)
-	 * P1.1
-	 *    NORMAL/ENHANCED- 7.5% (0x02)
-	 *
-	 * EVT1 and later
-	 *    ENHANCED   - 17%  (0x03)
-	 *    NORMAL     - 12%  (0x02)
-	 *               - 7.5% (0x01)
-	 *
-	 * Set 0x00 to disable it
-	 */
-	if (ctx->panel_rev == PANEL_REV_PROTO1) {
-		dbv_th = HK3_ACL_ZA_THRESHOLD_DBV_P1_0;
-		setting = 0x01;
-	} else if (ctx->panel_rev == PANEL_REV_PROTO1_1) {
-		dbv_th = HK3_ACL_ZA_THRESHOLD_DBV_P1_1;
-		setting = 0x02;
-	} else {
-		if (mode == ACL_ENHANCED) {
-			dbv_th = HK3_ACL_ENHANCED_THRESHOLD_DBV;
-			setting = 0x03;
-		} else if (mode == ACL_NORMAL) {
-			if (spanel->hw_dbv >= HK3_ACL_NORMAL_THRESHOLD_DBV_1 &&
-				spanel->hw_dbv < HK3_ACL_NORMAL_THRESHOLD_DBV_2) {
-				dbv_th = HK3_ACL_NORMAL_THRESHOLD_DBV_1;
-				setting = 0x01;
-			} else if (spanel->hw_dbv >= HK3_ACL_NORMAL_THRESHOLD_DBV_2) {
-				dbv_th = HK3_ACL_NORMAL_THRESHOLD_DBV_2;
-				setting = 0x02;
-			}
-		}
+	int i;
+
+	/* the highest level reached by DBV in HBM, 0x00 to disable it */
+	if (IS_HBM_ON(ctx->hbm_mode) && mode != ACL_OFF)
+		for (i = 0; i < HK3_ACL_LEVELS_MAX && levels[i].setting; i++)
+			if (spanel->hw_dbv >= levels[i].min_dbv)
+				setting = levels[i].setting;
+
+	if (spanel->hw_acl_setting == setting)
+		return false;
+
+	HK3_DCS_BUF_ADD(ctx, 0x55, setting);
+	spanel->hw_acl_setting = setting;
+	dev_info(ctx->dev, "%s: %d\n", __func__, setting);
+
+	return true;
+}
+
+static void hk3_txn_schedule(struct hk3_panel *spanel)
+{
+	schedule_delayed_work(&spanel->txn_work,
+		usecs_to_jiffies(2 * EXYNOS_VREFRESH_TO_PERIOD_USEC(spanel->hw_vrefresh)));
+}
+
+/**
+ * hk3_txn_commit - send the panel states marked in this commit
+ * @ctx: exynos_panel struct
+ *
+ * Display mode (HBM, LHBM and dimming bits) and panel features marked by setters,
+ * the DBV set by hk3_set_brightness(), either marked or staged along with the matrix,
+ * and the ACL setting depending on them are sent in one F0 key scope with a single
+ * flush. Only what changed is sent.
+ */
+static void hk3_txn_commit(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const bool hbm_on = IS_HBM_ON(ctx->hbm_mode);
+	u32 dirty = spanel->txn_dirty;
+	u32 dbv = spanel->txn_dbv;
+	bool staged;
+
+	spanel->txn_dirty = 0;
+	/* the matrix is applied here, the dbv has to be sent in the same frame */
+	staged = ea_panel_commit_staged(&spanel->ea, &dbv);
+	if (staged)
+		dirty |= HK3_TXN_DBV | HK3_TXN_ACL;
+	if (!dirty)
+		return;
+
+	DPU_ATRACE_BEGIN(__func__);
+	hk3_key_get(ctx);
+	/* display mode goes before panel features if leaving HBM, after if entering */
+	if ((dirty & HK3_TXN_WRCTRLD) && !hbm_on)
+		HK3_DCS_BUF_ADD(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY, hk3_get_wrctrld(ctx));
+	if (dirty & HK3_TXN_FEAT)
+		hk3_set_panel_feat(ctx, drm_mode_vrefresh(&ctx->current_mode->mode),
+				   spanel->auto_mode_vrefresh, spanel->feat, false);
+	if ((dirty & HK3_TXN_WRCTRLD) && hbm_on)
+		HK3_DCS_BUF_ADD(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY, hk3_get_wrctrld(ctx));
+	if (dirty & HK3_TXN_DBV) {
+		HK3_DCS_BUF_ADD(ctx, MIPI_DCS_SET_DISPLAY_BRIGHTNESS, dbv >> 8, dbv & 0xff);
+		spanel->hw_dbv = dbv;
 	}
+	if ((dirty & HK3_TXN_ACL) && hk3_update_acl(ctx, ctx->acl_mode) &&
+	    spanel->variant.rev->za_follows_acl)
+		hk3_sync_za(ctx);
+	hk3_key_put(ctx, true);
+
+	if (staged)
+		ea_trace_dbv_latch(&spanel->ea, dbv);
+	DPU_ATRACE_END(__func__);
+}
+
+/* whether a frame commit is in flight, marked states are sent in its commit_done */
+static bool hk3_commit_pending(struct exynos_panel *ctx)
+{
+	const struct drm_connector_state *conn_state = ctx->exynos_connector.base.state;
+	struct drm_crtc *crtc = conn_state ? conn_state->crtc : NULL;
+	struct drm_crtc_commit *commit;
+	bool pending = false;
+
+	if (!crtc)
+		return false;
+
+	spin_lock(&crtc->commit_lock);
+	commit = list_first_entry_or_null(&crtc->commit_list, struct drm_crtc_commit,
+					  commit_entry);
+	if (commit)
+		pending = !completion_done(&commit->flip_done);
+	spin_unlock(&crtc->commit_lock);
+
+	return pending;
+}
+
+/*
+ * Send marked states right away if no frame commit is in flight, e.g. on a sysfs
+ * backlight write. Otherwise they go with the commit, the work only covers a commit
+ * failing to reach commit_done.
+ */
+static void hk3_txn_kick(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
 
-	enable_acl = (spanel->hw_dbv >= dbv_th && IS_HBM_ON(ctx->hbm_mode) && mode != ACL_OFF);
-	if (enable_acl == false)
-		setting = 0;
+	if (is_panel_active(ctx) && !ctx->current_mode->exynos_mode.is_lp_mode &&
+	    !hk3_commit_pending(ctx))
+		hk3_txn_commit(ctx);
+	else
+		hk3_txn_schedule(spanel);
+}
 
-	if (spanel->hw_acl_setting != setting) {
-		EXYNOS_DCS_WRITE_SEQ(ctx, 0x55, setting);
-		spanel->hw_acl_setting = setting;
-		dev_info(ctx->dev, "%s: %d\n", __func__, setting);
-		/* Keep ZA off after EVT1 */
-		if (ctx->panel_rev < PANEL_REV_EVT1)
-			hk3_update_za(ctx);
-	}
+/* mark @states to be sent at the end of this commit, or right away if no commit follows */
+static void hk3_txn_mark(struct exynos_panel *ctx, u32 states)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	spanel->txn_dirty |= states;
+	/* while frozen, left to the next commit or kicked once thawed */
+	if (!spanel->txn_frozen)
+		hk3_txn_kick(ctx);
+}
+
+/* za is updated along with acl in hk3_txn_commit() */
+static void hk3_set_acl_mode(struct exynos_panel *ctx, enum exynos_acl_mode mode)
+{
+	hk3_txn_mark(ctx, HK3_TXN_ACL);
 }
 
 static int hk3_set_brightness(struct exynos_panel *ctx, u16 br)
 {
-	int ret;
-	u16 brightness, orig_br;
+	u16 orig_br;
+	u32 dbv;
 	struct hk3_panel *spanel = to_spanel(ctx);
 
 	if (ctx->current_mode->exynos_mode.is_lp_mode) {
@@ -1456,7 +2515,7 @@ static int hk3_set_brightness(struct exynos_panel *ctx, u16 br)
 		}
 		funcs = ctx->desc->exynos_panel_func;
 		if (funcs && funcs->set_binned_lp)
-			funcs->set_binned_lp(ctx, br);
+			funcs->set_binned_lp(ctx, ea_panel_calc_lp_backlight(&spanel->ea, br));
 		return 0;
 	}
 
@@ -1474,17 +2533,33 @@ static int hk3_set_brightness(struct exynos_panel *ctx, u16 br)
 	}
 
 	orig_br = br;
-	if (use_linear_matrix)
-		br = ea_panel_calc_backlight(br);
-	brightness = (br & 0xff) << 8 | br >> 8;
-	ret = exynos_dcs_set_brightness(ctx, brightness);
-	if (!ret) {
-		spanel->hw_dbv = br;
+	/* ramp the matrix along with DDIC dimming */
+	ea_set_ramp_frames(&spanel->ea, hk3_get_dimming_frames(ctx));
+	/* the matrix is only touched if it has to be changed */
+	if (ea_panel_stage_backlight(&spanel->ea, br, &dbv)) {
+		/* matrix and dbv are sent together in commit_done, or after LHBM is effective */
 		spanel->requested_brightness = orig_br;
-		hk3_set_acl_mode(ctx, ctx->acl_mode);
+		hk3_txn_mark(ctx, 0);
+		return 0;
 	}
+	/* sent along with the ACL setting depending on it */
+	spanel->txn_dbv = dbv;
+	spanel->requested_brightness = orig_br;
+	hk3_txn_mark(ctx, HK3_TXN_DBV | HK3_TXN_ACL);
 
-	return ret;
+	return 0;
+}
+
+static void hk3_txn_work(struct work_struct *work)
+{
+	struct hk3_panel *spanel = container_of(to_delayed_work(work), struct hk3_panel,
+						txn_work);
+	struct exynos_panel *ctx = &spanel->base;
+
+	mutex_lock(&ctx->mode_lock);
+	if (is_panel_active(ctx) && !ctx->current_mode->exynos_mode.is_lp_mode)
+		hk3_txn_commit(ctx);
+	mutex_unlock(&ctx->mode_lock);
 }
 
 static const struct exynos_dsi_cmd hk3_display_on_cmds[] = {
@@ -1592,120 +2667,172 @@ static bool hk3_is_peak_vrefresh(u32 vrefresh, bool is_ns)
 	return (is_ns && vrefresh == 60) || (!is_ns && vrefresh == 120);
 }
 
-static void hk3_set_lp_mode(struct exynos_panel *ctx, const struct exynos_panel_mode *pmode)
+static const struct hk3_state_route *hk3_get_state_route(struct exynos_panel *ctx,
+							 enum hk3_state to)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const struct hk3_state_route *route =
+		hk3_state_get_route(&spanel->state_routes, spanel->hw_state, to);
+
+	dev_dbg(ctx->dev, "state %s -> %s: %u transitions, cmds %#x, %u frames\n",
+		hk3_state_name(spanel->hw_state), hk3_state_name(to), route->hops,
+		route->cmds, route->cost_frames);
+
+	return route;
+}
+
+/* binned LP commands are sent by the core driver, so don't trust the shadow after them */
+static void hk3_set_binned_lp(struct exynos_panel *ctx, const u16 brightness)
+{
+	exynos_panel_set_binned_lp(ctx, brightness);
+	hk3_shadow_reset(&to_spanel(ctx)->shadow);
+}
+
+/* HK3_SCMD_AOD_ON step, display is off here and gets on in its own step */
+static void hk3_enter_aod(struct exynos_panel *ctx, u32 vrefresh)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
 	const u16 brightness = exynos_panel_get_brightness(ctx);
+
+	/* set dbv before entering lp mode */
+	HK3_DCS_BUF_ADD_SET_AND_FLUSH(ctx, aod_dbv);
+	hk3_wait_for_vsync_done(ctx, vrefresh, false);
+
+	HK3_DCS_BUF_ADD_SET_AND_FLUSH(ctx, aod_on);
+	/* dim AOD below the LP threshold with the matrix at the same panel mode */
+	hk3_set_binned_lp(ctx, ea_panel_calc_lp_backlight(&spanel->ea, brightness));
+	hk3_key_get(ctx);
+	/* Fixed TE: sync on */
+	HK3_DCS_BUF_ADD_REG(ctx, 0xB9, 0x51);
+	/* Default TE pulse width 693us */
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x08, 0xB9, 0x0B, 0xE0, 0x00, 0x2F, 0x0B, 0xE0, 0x00, 0x2F);
+	/* Frequency set for AOD */
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x02, 0xB9, 0x00);
+	/* Auto frame insertion: 1Hz */
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x18, 0xBD);
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0x04, 0x00, 0x74);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0xB8, 0xBD);
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x08);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0xC8, 0xBD);
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0x03);
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0xA7);
+	/* Enable early exit */
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0xE8, 0xBD);
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0x00);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x10, 0xBD);
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0x22);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x82, 0xBD);
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0x22, 0x22, 0x22, 0x22);
+	HK3_DCS_BUF_ADD_SET(ctx, freq_update);
+	hk3_key_put(ctx, true);
+
+	spanel->hw_vrefresh = 30;
+	/* AOD settings above override early-exit and frequency setting */
+	spanel->hw_early_exit_seq = NULL;
+	spanel->hw_frame_seq = NULL;
+}
+
+static void hk3_set_lp_mode(struct exynos_panel *ctx, const struct exynos_panel_mode *pmode)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
 	bool is_changeable_te = !test_bit(FEAT_EARLY_EXIT, spanel->feat);
 	bool is_ns = test_bit(FEAT_OP_NS, spanel->feat);
 	bool panel_enabled = is_panel_enabled(ctx);
 	u32 vrefresh = panel_enabled ? spanel->hw_vrefresh : 60;
+	const struct hk3_state_route *route = hk3_get_state_route(ctx, HK3_STATE_LP);
 
 	dev_dbg(ctx->dev, "%s: panel: %s\n", __func__, panel_enabled ? "ON" : "OFF");
 
 	DPU_ATRACE_BEGIN(__func__);
 
-	if (use_linear_matrix)
-		ea_panel_calc_backlight(0); /* turn off matrix */
+	ea_panel_calc_backlight(&spanel->ea, 0); /* turn off matrix */
 
-	hk3_disable_panel_feat(ctx, vrefresh);
-	if (panel_enabled) {
-		/* init sequence has sent display-off command already */
+	if (route->cmds & HK3_SCMD_FEAT_OFF)
+		hk3_disable_panel_feat(ctx, vrefresh);
+	if (route->cmds & HK3_SCMD_DISPLAY_OFF) {
 		if (!hk3_is_peak_vrefresh(vrefresh, is_ns) && is_changeable_te)
 			hk3_wait_for_vsync_done_changeable(ctx, vrefresh, is_ns);
 		else
 			hk3_wait_for_vsync_done(ctx, vrefresh, is_ns);
-		hk3_set_default_dimming(ctx, spanel->feat, true);
-		exynos_panel_send_cmd_set(ctx, &hk3_display_off_cmd_set);
+		hk3_set_default_dimming(ctx, spanel->feat);
+		hk3_send_cmd_set(ctx, &hk3_display_off_cmd_set);
 	}
-	/* display should be off here, set dbv before entering lp mode */
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, aod_dbv);
-	hk3_wait_for_vsync_done(ctx, vrefresh, false);
-
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, aod_on);
-	exynos_panel_set_binned_lp(ctx, brightness);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	/* Fixed TE: sync on */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x51);
-	/* Default TE pulse width 693us */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x08, 0xB9);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x0B, 0xE0, 0x00, 0x2F, 0x0B, 0xE0, 0x00, 0x2F);
-	/* Frequency set for AOD */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x02, 0xB9);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x00);
-	/* Auto frame insertion: 1Hz */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x18, 0xBD);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x04, 0x00, 0x74);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0xB8, 0xBD);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00, 0x08);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0xC8, 0xBD);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x03);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0xA7);
-	/* Enable early exit */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0xE8, 0xBD);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x00);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x10, 0xBD);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x22);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x82, 0xBD);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x22, 0x22, 0x22, 0x22);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
-	exynos_panel_send_cmd_set(ctx, &hk3_display_on_cmd_set);
-
-	spanel->hw_vrefresh = 30;
-	spanel->read_vreg = true;
+	if (route->cmds & HK3_SCMD_AOD_ON)
+		hk3_enter_aod(ctx, vrefresh);
+	if (route->cmds & HK3_SCMD_DISPLAY_ON) {
+		hk3_send_cmd_set(ctx, &hk3_display_on_cmd_set);
+		spanel->read_vreg = true;
+	}
+	spanel->hw_state = HK3_STATE_LP;
 
 	DPU_ATRACE_END(__func__);
 
 	dev_info(ctx->dev, "enter %dhz LP mode\n", drm_mode_vrefresh(&pmode->mode));
 }
 
-static void hk3_set_nolp_mode(struct exynos_panel *ctx,
-			      const struct exynos_panel_mode *pmode)
+/* display gets off after AOD exit */
+static void hk3_exit_aod(struct exynos_panel *ctx)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
 
-	dev_dbg(ctx->dev, "%s\n", __func__);
-
-	DPU_ATRACE_BEGIN(__func__);
-
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+	hk3_key_get(ctx);
 	/* manual mode */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x21);
+	HK3_DCS_BUF_ADD(ctx, 0xBD, 0x21);
 	/* Changeable TE is a must to ensure command sync */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x04);
-	/* Changeable TE width setting and frequency */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x04, 0xB9);
-	/* width 693us in AOD mode */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x0B, 0xE0, 0x00, 0x2F);
+	HK3_DCS_BUF_ADD_REG(ctx, 0xB9, 0x04);
+	/* Changeable TE width setting and frequency, width 693us in AOD mode */
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x04, 0xB9, 0x0B, 0xE0, 0x00, 0x2F);
 	/* AOD 30Hz */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x01, 0x60);
-	EXYNOS_DCS_BUF_ADD(ctx, 0x60, 0x00);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x01, 0x60);
+	HK3_DCS_BUF_ADD(ctx, 0x60, 0x00);
+	HK3_DCS_BUF_ADD_SET(ctx, freq_update);
+	hk3_key_put(ctx, true);
 	spanel->hw_idle_vrefresh = 0;
 
 	hk3_wait_for_vsync_done(ctx, 30, false);
-	exynos_panel_send_cmd_set(ctx, &hk3_display_off_cmd_set);
+	hk3_send_cmd_set(ctx, &hk3_display_off_cmd_set);
 
 	hk3_wait_for_vsync_done(ctx, 30, false);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+	hk3_key_get(ctx);
 	/* TE width setting */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x04, 0xB9);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x0B, 0xBB, 0x00, 0x2F, /* changeable TE */
-			   0x0B, 0xBB, 0x00, 0x2F, 0x0B, 0xBB, 0x00, 0x2F); /* fixed TE */
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x04, 0xB9, 0x0B, 0xBB, 0x00, 0x2F, /* changeable TE */
+			      0x0B, 0xBB, 0x00, 0x2F, 0x0B, 0xBB, 0x00, 0x2F); /* fixed TE */
 	/* disabling AOD low Mode is a must before aod-off */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x52, 0x94);
-	EXYNOS_DCS_BUF_ADD(ctx, 0x94, 0x00);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, lock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, aod_off);
-	hk3_update_panel_feat(ctx, drm_mode_vrefresh(&pmode->mode), true);
-	/* backlight control and dimming */
-	hk3_set_override_dimming(ctx, spanel->feat, true);
-	hk3_write_display_mode(ctx, &pmode->mode);
-	hk3_change_frequency(ctx, pmode);
-	exynos_panel_send_cmd_set(ctx, &hk3_display_on_cmd_set);
-	spanel->read_vreg = true;
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x52, 0x94);
+	HK3_DCS_BUF_ADD(ctx, 0x94, 0x00);
+	hk3_key_put(ctx, false);
+	HK3_DCS_BUF_ADD_SET_AND_FLUSH(ctx, aod_off);
+}
+
+static void hk3_set_nolp_mode(struct exynos_panel *ctx,
+			      const struct exynos_panel_mode *pmode)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const struct hk3_state_route *route = hk3_get_state_route(ctx, HK3_STATE_NORMAL);
+
+	dev_dbg(ctx->dev, "%s\n", __func__);
+
+	DPU_ATRACE_BEGIN(__func__);
+
+	/* drop AOD dimming, normal brightness update applies its own matrix */
+	ea_panel_calc_backlight(&spanel->ea, 0);
+
+	if (route->cmds & HK3_SCMD_AOD_OFF)
+		hk3_exit_aod(ctx);
+	if (route->cmds & HK3_SCMD_FEAT) {
+		hk3_key_begin(ctx);
+		hk3_update_panel_feat(ctx, drm_mode_vrefresh(&pmode->mode), true);
+		/* backlight control and dimming */
+		hk3_set_override_dimming(ctx, spanel->feat);
+		hk3_write_display_mode(ctx, &pmode->mode);
+		hk3_change_frequency(ctx, pmode);
+		hk3_key_put(ctx, true);
+	}
+	if (route->cmds & HK3_SCMD_DISPLAY_ON) {
+		hk3_send_cmd_set(ctx, &hk3_display_on_cmd_set);
+		spanel->read_vreg = true;
+	}
+	spanel->hw_state = HK3_STATE_NORMAL;
 
 	DPU_ATRACE_END(__func__);
 
@@ -1783,45 +2910,42 @@ static void hk3_lhbm_luminance_opr_setting(struct exynos_panel *ctx)
 	struct hk3_panel *spanel = to_spanel(ctx);
 	bool is_ns_mode = test_bit(FEAT_OP_NS, spanel->feat);
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x02, 0xF9, 0x95);
+	hk3_key_get(ctx);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x02, 0xF9, 0x95);
 	/* DBV setting */
-	EXYNOS_DCS_BUF_ADD(ctx, 0x95, 0x00, 0x40, 0x0C, 0x01, 0x90, 0x33, 0x06, 0x60,
+	HK3_DCS_BUF_ADD(ctx, 0x95, 0x00, 0x40, 0x0C, 0x01, 0x90, 0x33, 0x06, 0x60,
 				0xCC, 0x11, 0x92, 0x7F);
-	EXYNOS_DCS_BUF_ADD(ctx, 0x71, 0xC6, 0x00, 0x00, 0x19);
+	HK3_DCS_BUF_ADD(ctx, 0x71, 0xC6, 0x00, 0x00, 0x19);
 	/* 120Hz base (HS) offset */
-	EXYNOS_DCS_BUF_ADD(ctx, 0x6C, 0x9C, 0x9F, 0x59, 0x58, 0x50, 0x2F, 0x2B, 0x2E);
-	EXYNOS_DCS_BUF_ADD(ctx, 0x71, 0xC6, 0x00, 0x00, 0x6A);
+	HK3_DCS_BUF_ADD(ctx, 0x6C, 0x9C, 0x9F, 0x59, 0x58, 0x50, 0x2F, 0x2B, 0x2E);
+	HK3_DCS_BUF_ADD(ctx, 0x71, 0xC6, 0x00, 0x00, 0x6A);
 	/* 60Hz base (NS) offset */
-	EXYNOS_DCS_BUF_ADD(ctx, 0x6C, 0xA0, 0xA7, 0x57, 0x5C, 0x52, 0x37, 0x37, 0x40);
+	HK3_DCS_BUF_ADD(ctx, 0x6C, 0xA0, 0xA7, 0x57, 0x5C, 0x52, 0x37, 0x37, 0x40);
 
 	/* Target frequency */
-	EXYNOS_DCS_BUF_ADD(ctx, 0x60, is_ns_mode ? 0x18 : 0x00);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
+	HK3_DCS_BUF_ADD(ctx, 0x60, is_ns_mode ? 0x18 : 0x00);
+	HK3_DCS_BUF_ADD_SET(ctx, freq_update);
 	/* Opposite setting of target frequency */
-	EXYNOS_DCS_BUF_ADD(ctx, 0x60, is_ns_mode ? 0x00 : 0x18);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
+	HK3_DCS_BUF_ADD(ctx, 0x60, is_ns_mode ? 0x00 : 0x18);
+	HK3_DCS_BUF_ADD_SET(ctx, freq_update);
 	/* Target frequency */
-	EXYNOS_DCS_BUF_ADD(ctx, 0x60, is_ns_mode ? 0x18 : 0x00);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	HK3_DCS_BUF_ADD(ctx, 0x60, is_ns_mode ? 0x18 : 0x00);
+	HK3_DCS_BUF_ADD_SET(ctx, freq_update);
+	hk3_key_put(ctx, true);
 }
 
 static void hk3_negative_field_setting(struct exynos_panel *ctx)
 {
 	/* all settings will take effect in AOD mode automatically */
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+	hk3_key_get(ctx);
 	/* Vint -3V */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x21, 0xF4);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF4, 0x1E);
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x21, 0xF4, 0x1E);
 	/* Vaint -4V */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x69, 0xF4);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF4, 0x78);
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x69, 0xF4, 0x78);
 	/* VGL -8V */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x17, 0xF4);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF4, 0x1E);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x17, 0xF4, 0x1E);
+	HK3_DCS_BUF_ADD_SET(ctx, freq_update);
+	hk3_key_put(ctx, true);
 }
 
 static int hk3_enable(struct drm_panel *panel)
@@ -1833,6 +2957,7 @@ static int hk3_enable(struct drm_panel *panel)
 	const bool needs_reset = !is_panel_enabled(ctx);
 	bool is_ns = needs_reset ? false : test_bit(FEAT_OP_NS, spanel->feat);
 	struct drm_dsc_picture_parameter_set pps_payload;
+	const struct hk3_state_route *route;
 	bool is_fhd;
 	u32 vrefresh;
 
@@ -1848,8 +2973,18 @@ static int hk3_enable(struct drm_panel *panel)
 
 	DPU_ATRACE_BEGIN(__func__);
 
+	/* power may be cut without disable, or panel is enabled by bootloader */
 	if (needs_reset)
+		spanel->hw_state = HK3_STATE_OFF;
+	else if (spanel->hw_state == HK3_STATE_OFF)
+		spanel->hw_state = HK3_STATE_NORMAL;
+	route = hk3_get_state_route(ctx, pmode->exynos_mode.is_lp_mode ?
+				    HK3_STATE_LP : HK3_STATE_NORMAL);
+
+	if (route->cmds & HK3_SCMD_RESET) {
 		exynos_panel_reset(ctx);
+		hk3_shadow_reset(&spanel->shadow);
+	}
 
 	if (ctx->mode_in_progress == MODE_RES_IN_PROGRESS) {
 		u32 te_width_us = hk3_get_te_width_usec(vrefresh, is_ns);
@@ -1871,43 +3006,49 @@ static int hk3_enable(struct drm_panel *panel)
 	EXYNOS_PPS_WRITE_BUF(ctx, &pps_payload);
 	PANEL_SEQ_LABEL_END("pps");
 
-	if (needs_reset) {
+	if (route->cmds & HK3_SCMD_RESET) {
 		PANEL_SEQ_LABEL_BEGIN("init_cmd");
-		exynos_panel_send_cmd_set(ctx, &hk3_init_cmd_set);
+		hk3_send_cmd_set(ctx, &hk3_init_cmd_set);
 		PANEL_SEQ_LABEL_END("init_cmd");
-		if (ctx->panel_rev == PANEL_REV_PROTO1)
+		if (spanel->variant.rev->lhbm_opr_setting)
 			hk3_lhbm_luminance_opr_setting(ctx);
-		if (ctx->panel_rev >= PANEL_REV_DVT1)
+		if (spanel->variant.rev->negative_field)
 			hk3_negative_field_setting(ctx);
 
 		spanel->is_pixel_off = false;
+		ea_reset(&spanel->ea);
 		ctx->dsi_hs_clk = MIPI_DSI_FREQ_DEFAULT;
+		spanel->hw_state = HK3_STATE_BLANK;
 	}
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xC3, is_fhd ? 0x0D : 0x0C);
+	hk3_key_get(ctx);
+	HK3_DCS_BUF_ADD(ctx, 0xC3, is_fhd ? 0x0D : 0x0C);
 	/* 8/10bit config for QHD/FHD */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x01, 0xF2);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF2, is_fhd ? 0x81 : 0x01);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	HK3_DCS_BUF_ADD_PARAM(ctx, 0x01, 0xF2, is_fhd ? 0x81 : 0x01);
+	hk3_key_put(ctx, true);
 
-	if (needs_reset && spanel->material == MATERIAL_E7_DOE)
-		exynos_panel_send_cmd_set(ctx, &hk3_ns_gamma_fix_cmd_set);
+	if ((route->cmds & HK3_SCMD_RESET) && spanel->variant.material->ns_gamma_fix)
+		hk3_send_cmd_set(ctx, &hk3_ns_gamma_fix_cmd_set);
 
 	if (pmode->exynos_mode.is_lp_mode) {
 		hk3_set_lp_mode(ctx, pmode);
 	} else {
-		hk3_update_panel_feat(ctx, vrefresh, true);
-		hk3_write_display_mode(ctx, mode); /* dimming and HBM */
-		hk3_change_frequency(ctx, pmode);
+		if (route->cmds & HK3_SCMD_FEAT) {
+			hk3_key_begin(ctx);
+			hk3_update_panel_feat(ctx, vrefresh, true);
+			hk3_write_display_mode(ctx, mode); /* dimming and HBM */
+			hk3_change_frequency(ctx, pmode);
+			hk3_key_put(ctx, true);
+		}
 
-		if (needs_reset || (ctx->panel_state == PANEL_STATE_BLANK)) {
+		if (route->cmds & HK3_SCMD_DISPLAY_ON) {
 			hk3_wait_for_vsync_done(ctx, needs_reset ? 60 : vrefresh, is_ns);
-			exynos_panel_send_cmd_set(ctx, &hk3_display_on_cmd_set);
+			hk3_send_cmd_set(ctx, &hk3_display_on_cmd_set);
 			spanel->read_vreg = true;
 		}
 
-		hk3_set_override_dimming(ctx, spanel->feat, true);
+		hk3_set_override_dimming(ctx, spanel->feat);
+		spanel->hw_state = HK3_STATE_NORMAL;
 	}
 
 	spanel->lhbm_ctl.hist_roi_configured = false;
@@ -1922,6 +3063,8 @@ static int hk3_disable(struct drm_panel *panel)
 	struct exynos_panel *ctx = container_of(panel, struct exynos_panel, panel);
 	struct hk3_panel *spanel = to_spanel(ctx);
 	u32 vrefresh = spanel->hw_vrefresh;
+	const struct hk3_state_route *route;
+	enum hk3_state state;
 	int ret;
 
 	dev_info(ctx->dev, "%s\n", __func__);
@@ -1937,22 +3080,44 @@ static int hk3_disable(struct drm_panel *panel)
 	if (ret)
 		return ret;
 
-	hk3_disable_panel_feat(ctx, 60);
-	/*
-	 * can't get crtc pointer here, fallback to sleep. hk3_disable_panel_feat() sends freq
-	 * update command to trigger early exit if auto mode is enabled before, waiting for one
-	 * frame (for either auto or manual mode) should be sufficient to make sure the previous
-	 * commands become effective.
-	 */
-	exynos_panel_msleep(EXYNOS_VREFRESH_TO_PERIOD_USEC(vrefresh) / 1000 + 1);
-
-	exynos_panel_send_cmd_set(ctx, &hk3_display_off_cmd_set);
-	exynos_panel_msleep(20);
-	if (ctx->panel_state == PANEL_STATE_OFF)
+	cancel_delayed_work_sync(&spanel->txn_work);
+	spanel->txn_dirty = 0;
+	spanel->txn_frozen = false;
+	spanel->op_hz_ts = 0;
+	spanel->op_hz_sent = false;
+	cancel_delayed_work_sync(&spanel->lowprio.work);
+	spanel->lowprio.pending = 0;
+	cancel_work_sync(&spanel->prebuild_work);
+	spanel->next_plan.valid = false;
+	ea_reset(&spanel->ea);
+
+	state = ctx->panel_state == PANEL_STATE_OFF ? HK3_STATE_OFF : HK3_STATE_BLANK;
+	route = hk3_get_state_route(ctx, state);
+
+	if (route->cmds & HK3_SCMD_FEAT_OFF) {
+		hk3_disable_panel_feat(ctx, 60);
+		/*
+		 * can't get crtc pointer here, fallback to sleep. hk3_disable_panel_feat() sends
+		 * freq update command to trigger early exit if auto mode is enabled before,
+		 * waiting for one frame (for either auto or manual mode) should be sufficient
+		 * to make sure the previous commands become effective.
+		 */
+		exynos_panel_msleep(EXYNOS_VREFRESH_TO_PERIOD_USEC(vrefresh) / 1000 + 1);
+	}
+	if (route->cmds & HK3_SCMD_DISPLAY_OFF) {
+		hk3_send_cmd_set(ctx, &hk3_display_off_cmd_set);
+		exynos_panel_msleep(20);
+	}
+	if (route->cmds & HK3_SCMD_SLEEP_IN) {
 		EXYNOS_DCS_WRITE_SEQ_DELAY(ctx, 100, MIPI_DCS_ENTER_SLEEP_MODE);
+		hk3_shadow_reset(&spanel->shadow);
+	}
+	spanel->hw_state = state;
 
 	/* panel register state gets reset after disabling hardware */
 	bitmap_clear(spanel->hw_feat, 0, FEAT_MAX);
+	spanel->hw_early_exit_seq = NULL;
+	spanel->hw_frame_seq = NULL;
 	spanel->hw_vrefresh = 60;
 	spanel->hw_idle_vrefresh = 0;
 	spanel->hw_acl_setting = 0;
@@ -2001,9 +3166,9 @@ static void hk3_update_idle_state(struct exynos_panel *ctx)
 
 	if (!ctx->idle_delay_ms && spanel->force_changeable_te) {
 		dev_dbg(ctx->dev, "sending early exit out cmd\n");
-		EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-		EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+		hk3_key_get(ctx);
+		HK3_DCS_BUF_ADD_SET(ctx, freq_update);
+		hk3_key_put(ctx, true);
 	} else {
 		/* turn off auto mode to prevent panel from lowering frequency too fast */
 		hk3_update_refresh_mode(ctx, ctx->current_mode, 0);
@@ -2012,26 +3177,82 @@ static void hk3_update_idle_state(struct exynos_panel *ctx)
 	DPU_ATRACE_END(__func__);
 }
 
+/*
+ * Build the feature update of the likely next idle transition after a commit, in
+ * @prebuild_work so neither the commit nor the latency critical idle enter or exit path
+ * spends time on it, the latter only checks and sends it:
+ * - in auto frame insertion, the next one is idle exit by hk3_update_idle_state() or
+ *   self refresh being disabled
+ * - otherwise in idle on self refresh mode, the next one is idle enter
+ */
+static void hk3_prebuild_next_feat(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const struct exynos_panel_mode *pmode = ctx->current_mode;
+	const u32 vrefresh = drm_mode_vrefresh(&pmode->mode);
+	DECLARE_BITMAP(feat, FEAT_MAX);
+	u32 idle_vrefresh = 0;
+
+	if (!test_bit(FEAT_FRAME_AUTO, spanel->feat)) {
+		if (pmode->idle_mode == IDLE_MODE_ON_SELF_REFRESH)
+			idle_vrefresh = hk3_get_min_idle_vrefresh(ctx, pmode);
+		if (!idle_vrefresh)
+			return;
+	}
+
+	bitmap_copy(feat, spanel->feat, FEAT_MAX);
+	hk3_set_refresh_mode_feat(feat, vrefresh, idle_vrefresh);
+	hk3_build_feat_plan(ctx, &spanel->next_plan, vrefresh, idle_vrefresh, feat, false);
+}
+
+static void hk3_prebuild_work(struct work_struct *work)
+{
+	struct hk3_panel *spanel = container_of(work, struct hk3_panel, prebuild_work);
+	struct exynos_panel *ctx = &spanel->base;
+
+	mutex_lock(&ctx->mode_lock);
+	if (is_panel_active(ctx) && !ctx->current_mode->exynos_mode.is_lp_mode)
+		hk3_prebuild_next_feat(ctx);
+	mutex_unlock(&ctx->mode_lock);
+}
+
 static void hk3_commit_done(struct exynos_panel *ctx)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
 
+	/* whatever is sent since the previous commit lands in this frame */
+	ea_panel_commit_done(&spanel->ea);
+	if (spanel->op_hz_sent) {
+		spanel->op_hz_switch_us = ktime_us_delta(ktime_get(), spanel->op_hz_ts);
+		spanel->op_hz_ts = 0;
+		spanel->op_hz_sent = false;
+	}
+
 	if (ctx->current_mode->exynos_mode.is_lp_mode)
 		return;
 
+	/* one F0 key scope for all updates below, unlocked only if any of them is sent */
+	hk3_key_begin(ctx);
+	hk3_txn_commit(ctx);
+
 	/* skip idle update if going through RRS */
 	if (ctx->mode_in_progress == MODE_RES_IN_PROGRESS ||
 	    ctx->mode_in_progress == MODE_RES_AND_RR_IN_PROGRESS) {
 		dev_dbg(ctx->dev, "%s: RRS in progress, skip\n", __func__);
-		return;
+		goto out;
 	}
 
 	hk3_update_idle_state(ctx);
 
-	hk3_update_za(ctx);
+	/* for inputs other than ACL, e.g. force_za_off, and OPR while za depends on it */
+	hk3_sync_za(ctx);
 
-	if (spanel->pending_temp_update)
-		hk3_update_disp_therm(ctx);
+	schedule_work(&spanel->prebuild_work);
+
+out:
+	hk3_key_put(ctx, true);
+	spanel->commit_dsi_packets = spanel->dsi_packets - spanel->commit_dsi_packets_mark;
+	spanel->commit_dsi_packets_mark = spanel->dsi_packets;
 }
 
 static void hk3_set_hbm_mode(struct exynos_panel *ctx,
@@ -2053,25 +3274,18 @@ static void hk3_set_hbm_mode(struct exynos_panel *ctx,
 		/* enforce IRC on for factory builds */
 #ifndef PANEL_FACTORY_BUILD
 		if (mode == HBM_ON_IRC_ON)
-			clear_bit(ctx->panel_rev >= PANEL_REV_EVT1 ?
-				  FEAT_IRC_Z_MODE : FEAT_IRC_OFF, spanel->feat);
+			clear_bit(spanel->variant.rev->irc_feat, spanel->feat);
 		else
-			set_bit(ctx->panel_rev >= PANEL_REV_EVT1 ?
-				FEAT_IRC_Z_MODE : FEAT_IRC_OFF, spanel->feat);
+			set_bit(spanel->variant.rev->irc_feat, spanel->feat);
 #endif
 	} else {
 		clear_bit(FEAT_HBM, spanel->feat);
-		clear_bit(ctx->panel_rev >= PANEL_REV_EVT1 ?
-			  FEAT_IRC_Z_MODE : FEAT_IRC_OFF, spanel->feat);
+		clear_bit(spanel->variant.rev->irc_feat, spanel->feat);
 	}
 
-	if (ctx->panel_state == PANEL_STATE_NORMAL) {
-		if (!IS_HBM_ON(mode))
-			hk3_write_display_mode(ctx, &pmode->mode);
-		hk3_update_panel_feat(ctx, drm_mode_vrefresh(&pmode->mode), false);
-		if (IS_HBM_ON(mode))
-			hk3_write_display_mode(ctx, &pmode->mode);
-	}
+	/* ACL depends on HBM as well */
+	if (ctx->panel_state == PANEL_STATE_NORMAL)
+		hk3_txn_mark(ctx, HK3_TXN_WRCTRLD | HK3_TXN_FEAT | HK3_TXN_ACL);
 }
 
 static void hk3_set_dimming_on(struct exynos_panel *ctx,
@@ -2084,7 +3298,7 @@ static void hk3_set_dimming_on(struct exynos_panel *ctx,
 		dev_info(ctx->dev,"in lp mode, skip to update");
 		return;
 	}
-	hk3_write_display_mode(ctx, &pmode->mode);
+	hk3_txn_mark(ctx, HK3_TXN_WRCTRLD);
 }
 
 static void hk3_set_local_hbm_brightness(struct exynos_panel *ctx, bool is_first_stage)
@@ -2143,10 +3357,34 @@ static void hk3_set_local_hbm_brightness(struct exynos_panel *ctx, bool is_first
 	dev_dbg(ctx->dev, "set %s brightness: [%d] %*ph\n",
 		ctl->overdrived ? "overdrive" : "normal",
 		ctl->overdrived ? group : -1, LHBM_BRT_LEN, brt);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, lhbm_brightness_index);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, cmd);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	hk3_key_get(ctx);
+	HK3_DCS_BUF_ADD_SET(ctx, lhbm_brightness_index);
+	HK3_DCS_BUF_ADD_SET(ctx, cmd);
+	hk3_key_put(ctx, true);
+}
+
+/* hold back matrix changes and txn work while LHBM is being turned on */
+static void hk3_ea_freeze(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	ea_freeze(&spanel->ea);
+	spanel->txn_frozen = true;
+}
+
+/* apply the brightness held back by exposure adjustment during LHBM enabling */
+static void hk3_ea_thaw(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	if (!spanel->txn_frozen)
+		return;
+
+	spanel->txn_frozen = false;
+	if (ea_thaw(&spanel->ea))
+		hk3_set_brightness(ctx, spanel->requested_brightness);
+	if (spanel->txn_dirty)
+		hk3_txn_kick(ctx);
 }
 
 static void hk3_set_local_hbm_mode(struct exynos_panel *ctx,
@@ -2155,8 +3393,12 @@ static void hk3_set_local_hbm_mode(struct exynos_panel *ctx,
 	const struct exynos_panel_mode *pmode = ctx->current_mode;
 	struct hk3_panel *spanel = to_spanel(ctx);
 
-	if (local_hbm_en)
-		hk3_set_default_dimming(ctx, spanel->feat, true);
+	hk3_key_begin(ctx);
+	if (local_hbm_en) {
+		/* keep DPP work off the fingerprint path until LHBM is effective */
+		hk3_ea_freeze(ctx);
+		hk3_set_default_dimming(ctx, spanel->feat);
+	}
 
 	/* TODO: LHBM Position & Size */
 	hk3_write_display_mode(ctx, &pmode->mode);
@@ -2165,8 +3407,11 @@ static void hk3_set_local_hbm_mode(struct exynos_panel *ctx,
 		hk3_set_local_hbm_brightness(ctx, true);
 
 	if (!local_hbm_en) {
-		hk3_set_override_dimming(ctx, spanel->feat, true);
+		hk3_set_override_dimming(ctx, spanel->feat);
+		/* in case LHBM is turned off before post enabling */
+		hk3_ea_thaw(ctx);
 	}
+	hk3_key_put(ctx, true);
 }
 
 static void hk3_set_local_hbm_mode_post(struct exynos_panel *ctx)
@@ -2175,6 +3420,7 @@ static void hk3_set_local_hbm_mode_post(struct exynos_panel *ctx)
 
 	if (spanel->lhbm_ctl.overdrived)
 		hk3_set_local_hbm_brightness(ctx, false);
+	hk3_ea_thaw(ctx);
 }
 
 static void hk3_mode_set(struct exynos_panel *ctx,
@@ -2207,14 +3453,31 @@ static int hk3_set_op_hz(struct exynos_panel *ctx, unsigned int hz)
 
 	DPU_ATRACE_BEGIN(__func__);
 
+	if (is_panel_active(ctx) && (hz == 60) != test_bit(FEAT_OP_NS, spanel->feat)) {
+		spanel->op_hz_ts = ktime_get();
+		spanel->op_hz_sent = false;
+	}
+
 	ctx->op_hz = hz;
 	if (hz == 60)
 		set_bit(FEAT_OP_NS, spanel->feat);
 	else
 		clear_bit(FEAT_OP_NS, spanel->feat);
 
-	if (is_panel_active(ctx))
+	/* idle targets supported depend on the operating mode */
+	if (spanel->auto_mode_vrefresh) {
+		spanel->auto_mode_vrefresh = hk3_get_min_idle_vrefresh(ctx, ctx->current_mode);
+		hk3_set_refresh_mode_feat(spanel->feat, vrefresh, spanel->auto_mode_vrefresh);
+	}
+
+	if (!is_panel_active(ctx)) {
+		/* cached until the panel is enabled */
+	} else if (!ctx->current_mode->exynos_mode.is_lp_mode) {
+		/* merged with mode set in the same commit, or sent at the end of the commit */
+		hk3_txn_mark(ctx, HK3_TXN_FEAT);
+	} else {
 		hk3_update_panel_feat(ctx, vrefresh, false);
+	}
 	dev_info(ctx->dev, "%s op_hz at %d\n",
 		is_panel_active(ctx) ? "set" : "cache", hz);
 
@@ -2228,53 +3491,60 @@ static int hk3_read_id(struct exynos_panel *ctx)
 	return exynos_panel_read_ddic_id(ctx);
 }
 
+static void hk3_bind_variant(struct hk3_panel *spanel, const struct hk3_rev_variant *rev,
+			     const struct hk3_material_desc *material)
+{
+	struct hk3_variant *v = &spanel->variant;
+	enum hk3_irc irc = HK3_IRC_PROTO;
+
+	if (rev->irc_flat)
+		irc = material->irc_e6 ? HK3_IRC_FLAT_E6 : HK3_IRC_FLAT;
+
+	v->rev = rev;
+	v->material = material;
+	v->irc = spanel->feat_cmds->irc[irc];
+	spanel->material = material->material;
+}
+
 /* Note the format is 0x<DAh><DBh><DCh> which is reverse of bootloader (0x<DCh><DBh><DAh>) */
-static void hk3_get_panel_material(struct exynos_panel *ctx, u32 id)
+static const struct hk3_material_desc *hk3_get_panel_material(struct exynos_panel *ctx, u32 id)
 {
-	struct hk3_panel *spanel = to_spanel(ctx);
+	int i;
 
-	switch (id) {
-	case 0x000A4000:
-		spanel->material = MATERIAL_E6;
-		break;
-	case 0x000A4020:
-		spanel->material = MATERIAL_E7_DOE;
-		break;
-	case 0x000A4420:
-		spanel->material = MATERIAL_E7;
-		break;
-	case 0x000A4520:
-		spanel->material = MATERIAL_LPC5;
-		break;
-	default:
-		dev_warn(ctx->dev, "unknown material from panel (%#x), default to E7\n", id);
-		spanel->material = MATERIAL_E7;
-		break;
-	}
+	for (i = 0; i < ARRAY_SIZE(hk3_materials); i++)
+		if (hk3_materials[i].id == id)
+			return &hk3_materials[i];
+
+	dev_warn(ctx->dev, "unknown material from panel (%#x), default to E7\n", id);
 
-	dev_info(ctx->dev, "%s: %d\n", __func__, spanel->material);
+	return HK3_MATERIAL_DEFAULT;
 }
 
 static void hk3_get_panel_rev(struct exynos_panel *ctx, u32 id)
 {
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const struct hk3_rev_variant *rev = &hk3_rev_variants[0];
 	/* extract command 0xDB */
 	u8 build_code = (id & 0xFF00) >> 8;
-	u8 rev = ((build_code & 0xE0) >> 3) | ((build_code & 0x0C) >> 2);
+	u8 rev_code = ((build_code & 0xE0) >> 3) | ((build_code & 0x0C) >> 2);
+	int i;
 
-	exynos_panel_get_panel_rev(ctx, rev);
+	exynos_panel_get_panel_rev(ctx, rev_code);
 
-	hk3_get_panel_material(ctx, id);
+	for (i = 1; i < ARRAY_SIZE(hk3_rev_variants); i++)
+		if (ctx->panel_rev >= hk3_rev_variants[i].min_rev)
+			rev = &hk3_rev_variants[i];
+	hk3_bind_variant(spanel, rev, hk3_get_panel_material(ctx, id));
+
+	dev_info(ctx->dev, "%s: material %d\n", __func__, spanel->material);
 }
 
 static void hk3_normal_mode_work(struct exynos_panel *ctx)
 {
-	if (ctx->self_refresh_active) {
-		hk3_update_disp_therm(ctx);
-	} else {
-		struct hk3_panel *spanel = to_spanel(ctx);
-
-		spanel->pending_temp_update = true;
-	}
+	hk3_lowprio_queue(ctx, HK3_LOWPRIO_THERM);
+	/* no frame update is coming in self refresh */
+	if (ctx->self_refresh_active)
+		hk3_lowprio_kick(ctx);
 }
 
 static void hk3_pre_update_ffc(struct exynos_panel *ctx)
@@ -2283,11 +3553,11 @@ static void hk3_pre_update_ffc(struct exynos_panel *ctx)
 
 	DPU_ATRACE_BEGIN(__func__);
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+	hk3_key_get(ctx);
 	/* FFC off */
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x36, 0xC5);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xC5, 0x10);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x36, 0xC5);
+	HK3_DCS_BUF_ADD(ctx, 0xC5, 0x10);
+	hk3_key_put(ctx, true);
 
 	DPU_ATRACE_END(__func__);
 }
@@ -2299,6 +3569,7 @@ static void hk3_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 
 	DPU_ATRACE_BEGIN(__func__);
 
+	hk3_key_get(ctx);
 	if (hs_clk != MIPI_DSI_FREQ_DEFAULT && hs_clk != MIPI_DSI_FREQ_ALTERNATIVE) {
 		dev_warn(ctx->dev, "%s: invalid hs_clk=%d for FFC\n", __func__, hs_clk);
 	} else if (ctx->dsi_hs_clk != hs_clk) {
@@ -2306,28 +3577,25 @@ static void hk3_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 		ctx->dsi_hs_clk = hs_clk;
 
 		/* Update FFC */
-		EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x37, 0xC5);
+		HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x37, 0xC5);
 		if (hs_clk == MIPI_DSI_FREQ_DEFAULT)
-			EXYNOS_DCS_BUF_ADD(ctx, 0xC5, 0x10, 0x50, 0x05, 0x4D, 0x31, 0x40, 0x00,
+			HK3_DCS_BUF_ADD(ctx, 0xC5, 0x10, 0x50, 0x05, 0x4D, 0x31, 0x40, 0x00,
 						0x40, 0x00, 0x40, 0x00, 0x4D, 0x31, 0x40, 0x00,
 						0x40, 0x00, 0x40, 0x00, 0x4D, 0x31, 0x40, 0x00,
 						0x40, 0x00, 0x40, 0x00, 0x4D, 0x31, 0x40, 0x00,
 						0x40, 0x00, 0x40, 0x00);
 		else /* MIPI_DSI_FREQ_ALTERNATIVE */
-			EXYNOS_DCS_BUF_ADD(ctx, 0xC5, 0x10, 0x50, 0x05, 0x4E, 0x74, 0x40, 0x00,
+			HK3_DCS_BUF_ADD(ctx, 0xC5, 0x10, 0x50, 0x05, 0x4E, 0x74, 0x40, 0x00,
 						0x40, 0x00, 0x40, 0x00, 0x4E, 0x74, 0x40, 0x00,
 						0x40, 0x00, 0x40, 0x00, 0x4E, 0x74, 0x40, 0x00,
 						0x40, 0x00, 0x40, 0x00, 0x4E, 0x74, 0x40, 0x00,
 						0x40, 0x00, 0x40, 0x00);
-		EXYNOS_DCS_BUF_ADD_SET(ctx, lock_cmd_f0);
 	}
 
 	/* FFC on */
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x36, 0xC5);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xC5, 0x11);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x36, 0xC5);
+	HK3_DCS_BUF_ADD(ctx, 0xC5, 0x11);
+	hk3_key_put(ctx, true);
 
 	DPU_ATRACE_END(__func__);
 }
@@ -2691,22 +3959,23 @@ static void hk3_calc_lhbm_od_brightness(u8 n_fine, u8 n_coarse,
 
 static void hk3_lhbm_brightness_init(struct exynos_panel *ctx)
 {
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
 	struct hk3_panel *spanel = to_spanel(ctx);
 	struct hk3_lhbm_ctl *ctl = &spanel->lhbm_ctl;
-	int ret;
 	u8 g_coarse, b_coarse;
 	u8 *p_norm = ctl->brt_normal;
 	u8 *p_over;
 	enum hk3_lhbm_brt_overdrive_group grp;
+	struct panel_read read = PANEL_READ(lhbm_brightness_offset, lhbm_brightness_reg,
+					    p_norm, LHBM_BRT_LEN);
+	int ret;
 
-	EXYNOS_DCS_WRITE_TABLE(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_WRITE_TABLE(ctx, lhbm_brightness_index);
-	ret = mipi_dsi_dcs_read(dsi, lhbm_brightness_reg, p_norm, LHBM_BRT_LEN);
-	EXYNOS_DCS_WRITE_TABLE(ctx, lock_cmd_f0);
-	if (ret != LHBM_BRT_LEN) {
-		dev_err(ctx->dev, "failed to read lhbm brightness ret=%d\n", ret);
-		return;
+	if (!panel_calib_load(&hk3_calib, ctx, p_norm, LHBM_BRT_LEN)) {
+		ret = hk3_read_batch(ctx, &read, 1);
+		if (ret) {
+			dev_err(ctx->dev, "failed to read lhbm brightness ret=%d\n", ret);
+			return;
+		}
+		panel_calib_store(&hk3_calib, ctx, p_norm, LHBM_BRT_LEN);
 	}
 	dev_dbg(ctx->dev, "lhbm normal brightness: %*ph\n", LHBM_BRT_LEN, p_norm);
 
@@ -2772,11 +4041,249 @@ static void hk3_lhbm_brightness_init(struct exynos_panel *ctx)
 	}
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int hk3_dimming_profile_show(struct seq_file *m, void *data)
+{
+	struct hk3_panel *spanel = m->private;
+	const struct hk3_dimming_profile *profile;
+	u32 i;
+
+	seq_puts(m, "# min_brightness cmd cmd_ns cmd_hbm cmd_hbm_ns\n");
+	rcu_read_lock();
+	profile = rcu_dereference(spanel->dimming_profile);
+	for (i = 0; i < profile->num_segments; i++) {
+		const struct hk3_dimming_segment *seg = &profile->segments[i];
+
+		seq_printf(m, "%u %*ph %*ph %*ph %*ph\n", seg->min_brightness,
+			   HK3_DIMMING_CMD_LEN, seg->cmd[0][0][1],
+			   HK3_DIMMING_CMD_LEN, seg->cmd[0][1][1],
+			   HK3_DIMMING_CMD_LEN, seg->cmd[1][0][1],
+			   HK3_DIMMING_CMD_LEN, seg->cmd[1][1][1]);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+/* parse a segment in the format of hk3_dimming_profile_show() */
+static int hk3_parse_dimming_segment(char *buf, struct hk3_dimming_segment *seg)
+{
+	u8 cmd[2][2][HK3_DIMMING_CMD_LEN];
+	u8 *bytes = &cmd[0][0][0];
+	int i = 0, hbm, slow, ret;
+	char *tok;
+
+	while ((tok = strsep(&buf, " \t\n"))) {
+		if (!*tok)
+			continue;
+		if (i == 0)
+			ret = kstrtou16(tok, 0, &seg->min_brightness);
+		else if (i < 1 + sizeof(cmd))
+			ret = kstrtou8(tok, 16, &bytes[i - 1]);
+		else
+			ret = -EINVAL;
+		if (ret)
+			return ret;
+		i++;
+	}
+	if (i != 1 + sizeof(cmd))
+		return -EINVAL;
+
+	for (hbm = 0; hbm < 2; hbm++) {
+		for (slow = 0; slow < 2; slow++) {
+			memcpy(seg->cmd[hbm][slow][0], cmd[hbm][slow], HK3_DIMMING_CMD_LEN);
+			memcpy(seg->cmd[hbm][slow][1], cmd[hbm][slow], HK3_DIMMING_CMD_LEN);
+			seg->cmd[hbm][slow][0][0] |= 0x80;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Add or replace the segment starting at the same brightness, in the format shown, e.g.
+ * "600 00 43 43 03 00 43 43 03 00 43 43 03 00 43 43 03", or remove one by "del 600".
+ */
+static ssize_t hk3_dimming_profile_write(struct file *file, const char __user *ubuf,
+					 size_t len, loff_t *ppos)
+{
+	struct hk3_panel *spanel = ((struct seq_file *)file->private_data)->private;
+	const struct hk3_dimming_profile *old;
+	struct hk3_dimming_profile *profile;
+	struct hk3_dimming_segment seg;
+	bool del = false, merged = false, found = false;
+	char buf[128];
+	u32 i, n;
+	int ret;
+
+	if (len >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+
+	if (sscanf(buf, "del %hu", &seg.min_brightness) == 1) {
+		/* the first segment always starts at 0 */
+		if (!seg.min_brightness)
+			return -EINVAL;
+		del = true;
+	} else {
+		ret = hk3_parse_dimming_segment(buf, &seg);
+		if (ret)
+			return ret;
+	}
+
+	profile = kmalloc(sizeof(*profile), GFP_KERNEL);
+	if (!profile)
+		return -ENOMEM;
+
+	mutex_lock(&spanel->dimming_profile_lock);
+	old = rcu_dereference_protected(spanel->dimming_profile,
+					lockdep_is_held(&spanel->dimming_profile_lock));
+	/* merge @seg into the sorted segments, replacing or removing one at the same start */
+	for (i = 0, n = 0; i <= old->num_segments; i++) {
+		const struct hk3_dimming_segment *cur =
+			i < old->num_segments ? &old->segments[i] : NULL;
+
+		if (!merged && (!cur || cur->min_brightness >= seg.min_brightness)) {
+			merged = true;
+			if (!del) {
+				if (n == HK3_DIMMING_SEGMENTS_MAX)
+					goto nospc;
+				profile->segments[n++] = seg;
+			}
+			if (cur && cur->min_brightness == seg.min_brightness) {
+				found = true;
+				continue;
+			}
+		}
+		if (!cur)
+			break;
+		if (n == HK3_DIMMING_SEGMENTS_MAX)
+			goto nospc;
+		profile->segments[n++] = *cur;
+	}
+	/* nothing to delete, keep the profile published as is */
+	if (del && !found) {
+		ret = -ENOENT;
+		goto unlock;
+	}
+	profile->num_segments = n;
+	rcu_assign_pointer(spanel->dimming_profile, profile);
+	WRITE_ONCE(spanel->dimming_profile_seq, spanel->dimming_profile_seq + 1);
+	mutex_unlock(&spanel->dimming_profile_lock);
+
+	if (old != &hk3_dimming_profile_default)
+		kfree_rcu((struct hk3_dimming_profile *)old, rcu);
+
+	return len;
+
+nospc:
+	ret = -ENOSPC;
+unlock:
+	mutex_unlock(&spanel->dimming_profile_lock);
+	kfree(profile);
+	return ret;
+}
+
+static int hk3_dimming_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hk3_dimming_profile_show, inode->i_private);
+}
+
+static const struct file_operations hk3_dimming_profile_fops = {
+	.owner = THIS_MODULE,
+	.open = hk3_dimming_profile_open,
+	.read = seq_read,
+	.write = hk3_dimming_profile_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int hk3_state_show(struct seq_file *m, void *data)
+{
+	struct hk3_panel *spanel = m->private;
+	int i, j;
+
+	seq_printf(m, "state: %s\n", hk3_state_name(spanel->hw_state));
+	seq_puts(m, "# from to next hops cmds frames\n");
+	for (i = 0; i < HK3_STATE_MAX; i++) {
+		for (j = 0; j < HK3_STATE_MAX; j++) {
+			const struct hk3_state_route *route =
+				hk3_state_get_route(&spanel->state_routes, i, j);
+
+			if (!route->valid || !route->hops)
+				continue;
+			seq_printf(m, "%s %s %s %u %#04x %u\n", hk3_state_name(i),
+				   hk3_state_name(j), hk3_state_name(route->next), route->hops,
+				   route->cmds, route->cost_frames);
+		}
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(hk3_state);
+
+static int hk3_shadow_show(struct seq_file *m, void *data)
+{
+	struct exynos_panel *ctx = m->private;
+	struct hk3_shadow *shadow = &to_spanel(ctx)->shadow;
+	const ktime_t now = ktime_get();
+	s64 delta_us;
+	u64 rate = 0;
+	u32 i;
+
+	mutex_lock(&ctx->mode_lock);
+	delta_us = ktime_us_delta(now, shadow->mark_ts);
+	if (shadow->mark_ts && delta_us > 0)
+		rate = div64_u64((shadow->saved_bytes - shadow->saved_bytes_mark) * USEC_PER_SEC,
+				 delta_us);
+	shadow->saved_bytes_mark = shadow->saved_bytes;
+	shadow->mark_ts = now;
+
+	seq_printf(m, "saved_bytes: %llu\n", shadow->saved_bytes);
+	seq_printf(m, "saved_bytes_per_sec: %llu\n", rate);
+	seq_puts(m, "# reg offset data\n");
+	for (i = 0; i < shadow->num; i++) {
+		const struct hk3_shadow_entry *e = &shadow->entries[i];
+
+		seq_printf(m, "%02x %04x %*ph\n", e->reg, e->offset, e->len, e->data);
+	}
+	mutex_unlock(&ctx->mode_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(hk3_shadow);
+
+static int hk3_lowprio_show(struct seq_file *m, void *data)
+{
+	struct exynos_panel *ctx = m->private;
+	const struct hk3_lowprio *q = &to_spanel(ctx)->lowprio;
+	u32 i;
+
+	mutex_lock(&ctx->mode_lock);
+	seq_puts(m, "pending:");
+	for (i = 0; i < HK3_LOWPRIO_MAX; i++)
+		if (test_bit(i, &q->pending))
+			seq_printf(m, " %s", hk3_lowprio_descs[i].name);
+	seq_puts(m, "\n");
+	seq_printf(m, "max_delay_us: %u\n", q->max_delay_us);
+	seq_puts(m, "# delay_ms count\n");
+	for (i = 0; i < HK3_LOWPRIO_DELAY_BUCKETS - 1; i++)
+		seq_printf(m, "<%u %u\n", 1 << i, q->delay_hist[i]);
+	seq_printf(m, ">=%u %u\n", 1 << (HK3_LOWPRIO_DELAY_BUCKETS - 2), q->delay_hist[i]);
+	mutex_unlock(&ctx->mode_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(hk3_lowprio);
+#endif
+
 static void hk3_panel_init(struct exynos_panel *ctx)
 {
+	struct hk3_panel *spanel = to_spanel(ctx);
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *csroot = ctx->debugfs_cmdset_entry;
-	struct hk3_panel *spanel = to_spanel(ctx);
 
 	exynos_panel_debugfs_create_cmdset(ctx, csroot, &hk3_init_cmd_set, "init");
 	debugfs_create_bool("force_changeable_te", 0644, ctx->debugfs_entry,
@@ -2787,6 +4294,21 @@ static void hk3_panel_init(struct exynos_panel *ctx)
 				&spanel->force_za_off);
 	debugfs_create_u8("hw_acl_setting", 0644, ctx->debugfs_entry,
 				&spanel->hw_acl_setting);
+	debugfs_create_u32("dsi_packets", 0444, ctx->debugfs_entry, &spanel->dsi_packets);
+	debugfs_create_u32("commit_dsi_packets", 0444, ctx->debugfs_entry,
+				&spanel->commit_dsi_packets);
+	debugfs_create_u32("op_hz_switch_us", 0444, ctx->debugfs_entry,
+				&spanel->op_hz_switch_us);
+	debugfs_create_u32("next_plan_hits", 0444, ctx->debugfs_entry,
+				&spanel->next_plan_hits);
+	debugfs_create_u32("next_plan_misses", 0444, ctx->debugfs_entry,
+				&spanel->next_plan_misses);
+	debugfs_create_file("dimming_profile", 0644, ctx->debugfs_entry, spanel,
+			    &hk3_dimming_profile_fops);
+	debugfs_create_file("state", 0444, ctx->debugfs_entry, spanel, &hk3_state_fops);
+	debugfs_create_file("shadow", 0444, ctx->debugfs_entry, ctx, &hk3_shadow_fops);
+	debugfs_create_file("lowprio", 0444, ctx->debugfs_entry, ctx, &hk3_lowprio_fops);
+	ea_debugfs_init(&spanel->ea, ctx->debugfs_entry);
 #endif
 
 #ifdef PANEL_FACTORY_BUILD
@@ -2794,15 +4316,15 @@ static void hk3_panel_init(struct exynos_panel *ctx)
 #endif
 	hk3_lhbm_brightness_init(ctx);
 
-	if (ctx->panel_rev < PANEL_REV_DVT1) {
+	if (spanel->variant.rev->aod_transition) {
 		/* AOD Transition Set */
-		EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x03, 0xBB);
-		EXYNOS_DCS_BUF_ADD(ctx, 0xBB, 0x41);
-		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+		hk3_key_get(ctx);
+		HK3_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x03, 0xBB);
+		HK3_DCS_BUF_ADD(ctx, 0xBB, 0x41);
+		hk3_key_put(ctx, true);
 	}
 
-	if (ctx->panel_rev >= PANEL_REV_DVT1)
+	if (spanel->variant.rev->negative_field)
 		hk3_negative_field_setting(ctx);
 
 	spanel->tz = thermal_zone_get_zone_by_name("disp_therm");
@@ -2811,22 +4333,87 @@ static void hk3_panel_init(struct exynos_panel *ctx)
 			__func__);
 }
 
+static void hk3_dimming_profile_release(void *data)
+{
+	struct hk3_panel *spanel = data;
+	const struct hk3_dimming_profile *profile =
+		rcu_dereference_protected(spanel->dimming_profile, true);
+
+	if (profile != &hk3_dimming_profile_default)
+		kfree(profile);
+}
+
+static void hk3_txn_release(void *data)
+{
+	struct hk3_panel *spanel = data;
+
+	cancel_delayed_work_sync(&spanel->txn_work);
+}
+
+static void hk3_lowprio_release(void *data)
+{
+	struct hk3_panel *spanel = data;
+
+	cancel_delayed_work_sync(&spanel->lowprio.work);
+}
+
+static void hk3_prebuild_release(void *data)
+{
+	struct hk3_panel *spanel = data;
+
+	cancel_work_sync(&spanel->prebuild_work);
+}
+
 static int hk3_panel_probe(struct mipi_dsi_device *dsi)
 {
+	const struct exynos_panel_desc *desc = of_device_get_match_data(&dsi->dev);
 	struct hk3_panel *spanel;
+	int ret;
 
 	spanel = devm_kzalloc(&dsi->dev, sizeof(*spanel), GFP_KERNEL);
 	if (!spanel)
 		return -ENOMEM;
 
+	ret = ea_init(&spanel->ea, &dsi->dev, &spanel->base.exynos_connector.base,
+		      desc->brt_capability);
+	if (ret)
+		return ret;
+	INIT_DELAYED_WORK(&spanel->txn_work, hk3_txn_work);
+	ret = devm_add_action_or_reset(&dsi->dev, hk3_txn_release, spanel);
+	if (ret)
+		return ret;
+	INIT_DELAYED_WORK(&spanel->lowprio.work, hk3_lowprio_work);
+	ret = devm_add_action_or_reset(&dsi->dev, hk3_lowprio_release, spanel);
+	if (ret)
+		return ret;
+	INIT_WORK(&spanel->prebuild_work, hk3_prebuild_work);
+	ret = devm_add_action_or_reset(&dsi->dev, hk3_prebuild_release, spanel);
+	if (ret)
+		return ret;
+
+	spanel->feat_cmds = hk3_build_feat_cmds(&dsi->dev);
+	if (!spanel->feat_cmds)
+		return -ENOMEM;
+	hk3_state_build_routes(&spanel->state_routes);
+
+	/* bound again once panel revision and material are read */
+	hk3_bind_variant(spanel, &hk3_rev_variants[ARRAY_SIZE(hk3_rev_variants) - 1],
+			 HK3_MATERIAL_DEFAULT);
+
+	mutex_init(&spanel->dimming_profile_lock);
+	RCU_INIT_POINTER(spanel->dimming_profile, &hk3_dimming_profile_default);
+	ret = devm_add_action_or_reset(&dsi->dev, hk3_dimming_profile_release, spanel);
+	if (ret)
+		return ret;
+
 	spanel->base.op_hz = 120;
 	spanel->hw_vrefresh = 60;
 	spanel->hw_acl_setting = 0;
 	spanel->hw_za_enabled = false;
 	spanel->hw_dbv = 0;
+	spanel->hw_state = HK3_STATE_OFF;
 	/* ddic default temp */
 	spanel->hw_temp = 25;
-	spanel->pending_temp_update = false;
 	spanel->is_pixel_off = false;
 	spanel->read_vreg = false;
 
@@ -2852,7 +4439,7 @@ static const struct exynos_panel_funcs hk3_exynos_funcs = {
 	.set_brightness = hk3_set_brightness,
 	.set_lp_mode = hk3_set_lp_mode,
 	.set_nolp_mode = hk3_set_nolp_mode,
-	.set_binned_lp = exynos_panel_set_binned_lp,
+	.set_binned_lp = hk3_set_binned_lp,
 	.set_hbm_mode = hk3_set_hbm_mode,
 	.set_dimming_on = hk3_set_dimming_on,
 	.set_local_hbm_mode = hk3_set_local_hbm_mode,
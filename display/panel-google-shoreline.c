@@ -12,6 +12,9 @@
 
 #include "include/trace/dpu_trace.h"
 #include "panel/panel-samsung-drv.h"
+#include "panel-calib.h"
+#include "panel-key.h"
+#include "panel-read.h"
 
 static const struct drm_dsc_config pps_config = {
 	.line_buf_depth = 9,
@@ -105,6 +108,7 @@ static const u8 sync_end[] = { 0x72, 0x2C, 0x2C, 0x81, 0x00, 0x00 };
 static const u8 freq_update[] = { 0xF7, 0x0F };
 static const u8 lhbm_brightness_index[] = { 0xB0, 0x03, 0xD7, 0x66 };
 static const u8 lhbm_brightness_reg = 0x66;
+static const int lhbm_brightness_offset = 0x03D7;
 
 static const struct exynos_dsi_cmd shoreline_lp_low_cmds[] = {
 	EXYNOS_DSI_CMD_SEQ_DELAY(34, MIPI_DCS_WRITE_CONTROL_DISPLAY, 0x25), /* AOD 10 nit */
@@ -261,29 +265,64 @@ struct shoreline_panel {
 
 	/** @vreg_cmd: vreg data */
 	u8 vreg_cmd[VREG_SET_CMD_SIZE];
+
+	/** @test_key_f0: F0 test key session */
+	struct panel_key test_key_f0;
+	/** @test_key_fc: FC test key session */
+	struct panel_key test_key_fc;
 };
 
+/**
+ * struct shoreline_calib - OTP settings kept in calibration cache
+ * @lhbm_gamma: lhbm gamma data, without write command
+ * @vreg: vreg data, without write command
+ * @brt_normal: normal LHBM brightness parameters
+ */
+struct shoreline_calib {
+	u8 lhbm_gamma[LHBM_GAMMA_CMD_SIZE - 1];
+	u8 vreg[VREG_SET_CMD_SIZE - 1];
+	u8 brt_normal[LHBM_BRT_LEN];
+} __packed;
+
+static DEFINE_PANEL_CALIB(shoreline_calib);
+PANEL_CALIB_MODULE_PARAM(shoreline_calib);
+
 #define to_spanel(ctx) container_of(ctx, struct shoreline_panel, base)
 
-static void shoreline_lhbm_gamma_read(struct exynos_panel *ctx)
+/* enable test key @key (f0 or fc) in a scope, only sent by the outermost one */
+#define SHORELINE_TEST_KEY_ON(ctx, key) do {					\
+	if (panel_key_get(&to_spanel(ctx)->test_key_##key, test_key_on_##key,	\
+			  ARRAY_SIZE(test_key_on_##key)))			\
+		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_##key);			\
+} while (0)
+
+/* close a scope of test key @key, disabling it at the outermost one */
+#define SHORELINE_TEST_KEY_OFF(ctx, key) do {					\
+	if (panel_key_put(&to_spanel(ctx)->test_key_##key))			\
+		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_off_##key);		\
+} while (0)
+
+/* as SHORELINE_TEST_KEY_OFF(), flushing at the outermost scope */
+#define SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, key) do {			\
+	if (panel_key_put(&to_spanel(ctx)->test_key_##key))			\
+		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_##key);	\
+} while (0)
+
+/*
+ * LHBM gamma and Vreg are read together by shoreline_otp_read(), these only fill in the
+ * write commands from the data read in.
+ */
+static void shoreline_lhbm_gamma_parse(struct exynos_panel *ctx, int ret)
 {
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
-	struct shoreline_panel *spanel = to_spanel(ctx);
-	int ret;
-	u8 *lhbm_gamma = spanel->lhbm_gamma;
+	u8 *lhbm_gamma = to_spanel(ctx)->lhbm_gamma;
 
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_on_f0);
-	EXYNOS_DCS_WRITE_SEQ(ctx, 0xB0, 0x00, 0x22, 0xD8); /* global para */
-	ret = mipi_dsi_dcs_read(dsi, 0xD8, lhbm_gamma + 1, LHBM_GAMMA_CMD_SIZE - 1);
-	if (ret == (LHBM_GAMMA_CMD_SIZE - 1)) {
+	if (!ret) {
 		/* fill in gamma write command 0x66 in offset 0 */
 		lhbm_gamma[0] = 0x66;
 		dev_info(ctx->dev, "lhbm gamma: %*phN\n", LHBM_GAMMA_CMD_SIZE - 1, lhbm_gamma + 1);
 	} else {
 		dev_err(ctx->dev, "fail to read LHBM gamma\n");
 	}
-
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_off_f0);
 }
 
 static void shoreline_lhbm_gamma_write(struct exynos_panel *ctx)
@@ -296,10 +335,10 @@ static void shoreline_lhbm_gamma_write(struct exynos_panel *ctx)
 	}
 
 	dev_dbg(ctx->dev, "%s\n", __func__);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
+	SHORELINE_TEST_KEY_ON(ctx, f0);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x03, 0xD7, 0x66); /* global para */
 	EXYNOS_DCS_BUF_ADD_SET(ctx, spanel->lhbm_gamma); /* write gamma */
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_f0);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 }
 
 static void shoreline_wait_for_vsync_done(struct exynos_panel *ctx)
@@ -316,33 +355,75 @@ static void shoreline_wait_for_vsync_done(struct exynos_panel *ctx)
 	DPU_ATRACE_END(__func__);
 }
 
-static void shoreline_vreg_read(struct exynos_panel *ctx)
+static void shoreline_vreg_parse(struct exynos_panel *ctx, int ret)
 {
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
-	struct shoreline_panel *spanel = to_spanel(ctx);
-	u8 *vreg_cmd = spanel->vreg_cmd;
-	int ret;
+	u8 *vreg_cmd = to_spanel(ctx)->vreg_cmd;
 
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_on_f0);
-	EXYNOS_DCS_WRITE_SEQ(ctx, 0xB0, 0x00, 0x3A , 0xF4); /* global para */
-	ret = mipi_dsi_dcs_read(dsi, 0xF4, vreg_cmd + 1, VREG_SET_CMD_SIZE - 1);
-	if (ret == (VREG_SET_CMD_SIZE - 1)) {
+	if (!ret) {
 		/* fill in vreg command 0xF4 in offset 0 */
 		vreg_cmd[0] = 0xF4;
 		dev_dbg(ctx->dev, "vreg: %*phN\n", VREG_SET_CMD_SIZE - 1, vreg_cmd + 1);
 	} else {
 		dev_err(ctx->dev, "fail to read vreg setting\n");
 	}
+}
 
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_off_f0);
-};
+/* read OTP settings in one test key session */
+static void shoreline_otp_read(struct exynos_panel *ctx)
+{
+	struct shoreline_panel *spanel = to_spanel(ctx);
+	struct panel_read reads[] = {
+		PANEL_READ(0x0022, 0xD8, spanel->lhbm_gamma + 1, LHBM_GAMMA_CMD_SIZE - 1),
+		PANEL_READ(0x003A, 0xF4, spanel->vreg_cmd + 1, VREG_SET_CMD_SIZE - 1),
+	};
+
+	SHORELINE_TEST_KEY_ON(ctx, f0);
+	panel_read_batch(ctx, reads, ARRAY_SIZE(reads));
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
+
+	shoreline_lhbm_gamma_parse(ctx, reads[0].ret);
+	shoreline_vreg_parse(ctx, reads[1].ret);
+}
+
+/* fill in OTP settings from calibration cache, return false if they have to be read */
+static bool shoreline_calib_load(struct exynos_panel *ctx)
+{
+	struct shoreline_panel *spanel = to_spanel(ctx);
+	struct shoreline_calib calib;
+
+	if (!panel_calib_load(&shoreline_calib, ctx, &calib, sizeof(calib)))
+		return false;
+
+	spanel->lhbm_gamma[0] = 0x66;
+	memcpy(spanel->lhbm_gamma + 1, calib.lhbm_gamma, sizeof(calib.lhbm_gamma));
+	spanel->vreg_cmd[0] = 0xF4;
+	memcpy(spanel->vreg_cmd + 1, calib.vreg, sizeof(calib.vreg));
+	memcpy(spanel->lhbm_ctl.brt_normal, calib.brt_normal, sizeof(calib.brt_normal));
+
+	return true;
+}
+
+/* save OTP settings once all of them are read */
+static void shoreline_calib_store(struct exynos_panel *ctx)
+{
+	struct shoreline_panel *spanel = to_spanel(ctx);
+	struct shoreline_calib calib;
+
+	if (!spanel->lhbm_gamma[0] || !spanel->vreg_cmd[0])
+		return;
+
+	memcpy(calib.lhbm_gamma, spanel->lhbm_gamma + 1, sizeof(calib.lhbm_gamma));
+	memcpy(calib.vreg, spanel->vreg_cmd + 1, sizeof(calib.vreg));
+	memcpy(calib.brt_normal, spanel->lhbm_ctl.brt_normal, sizeof(calib.brt_normal));
+	panel_calib_store(&shoreline_calib, ctx, &calib, sizeof(calib));
+}
 
 static void shoreline_display_on(struct exynos_panel *ctx)
 {
 	struct shoreline_panel *spanel = to_spanel(ctx);
 
 	if (spanel->vreg_cmd[0]) {
-		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
+		SHORELINE_TEST_KEY_ON(ctx, f0);
 		EXYNOS_DCS_BUF_ADD_SET(ctx, sync_begin);
 		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x12, 0xF8); /* global para */
 		EXYNOS_DCS_BUF_ADD(ctx, 0xF8, 0x3F); /* auto power saving off */
@@ -353,7 +434,7 @@ static void shoreline_display_on(struct exynos_panel *ctx)
 		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x12, 0xF8); /* global para */
 		EXYNOS_DCS_BUF_ADD(ctx, 0xF8, 0x00); /* auto power saving on */
 		EXYNOS_DCS_BUF_ADD_SET(ctx, sync_end);
-		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_off_f0);
+		SHORELINE_TEST_KEY_OFF(ctx, f0);
 	}
 
 	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, MIPI_DCS_SET_DISPLAY_ON);
@@ -365,7 +446,7 @@ static void shoreline_display_off(struct exynos_panel *ctx)
 
 	EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_SET_DISPLAY_OFF);
 	if (spanel->vreg_cmd[0]) {
-		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
+		SHORELINE_TEST_KEY_ON(ctx, f0);
 		EXYNOS_DCS_BUF_ADD_SET(ctx, sync_begin);
 		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x12, 0xF8); /* global para */
 		EXYNOS_DCS_BUF_ADD(ctx, 0xF8, 0x3F); /* auto power saving off */
@@ -377,7 +458,7 @@ static void shoreline_display_off(struct exynos_panel *ctx)
 		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x12, 0xF8); /* global para */
 		EXYNOS_DCS_BUF_ADD(ctx, 0xF8, 0x00); /* auto power saving on */
 		EXYNOS_DCS_BUF_ADD_SET(ctx, sync_end);
-		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_off_f0);
+		SHORELINE_TEST_KEY_OFF(ctx, f0);
 	}
 
 	/* Empty command to flush */
@@ -391,11 +472,11 @@ static void shoreline_update_te(struct exynos_panel *ctx, const unsigned int vre
 		{0xB9, 0x00, 0x44, 0x00, 0x0C}, /* HS 120Hz */
 	};
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
+	SHORELINE_TEST_KEY_ON(ctx, f0);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, (vrefresh == 60) ? 0x11 : 0x31); /* TE SELECT */
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x10, 0xB9); /* global para */
 	EXYNOS_DCS_BUF_ADD_SET(ctx, te_setting[(vrefresh == 60) ? 0 : 1]); /* TE Width */
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_f0);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 }
 
 /**
@@ -445,13 +526,13 @@ static void shoreline_update_te2(struct exynos_panel *ctx)
 	dev_dbg(ctx->dev, "TE2 updated: rising=0x%X falling=0x%X for %uHz\n",
 		rising, falling, vrefresh);
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
+	SHORELINE_TEST_KEY_ON(ctx, f0);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x01, 0xB9); /* global para */
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, (vrefresh == 60) ? 0x04 : 0x31); /* TE2 SELECT */
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, (vrefresh == 60) ? 0x1A : 0x26, 0xB9); /* global para */
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, (rising >> 8) & 0xFF, rising & 0xFF,
 			     (falling >> 8) & 0xFF, falling & 0xFF); /* TE2 Width */
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_f0);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 }
 
 static void shoreline_change_frequency(struct exynos_panel *ctx,
@@ -460,12 +541,11 @@ static void shoreline_change_frequency(struct exynos_panel *ctx,
 	if (!ctx || (vrefresh != 60 && vrefresh != 120))
 		return;
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
+	SHORELINE_TEST_KEY_ON(ctx, f0);
 	EXYNOS_DCS_BUF_ADD(ctx, 0x60, (vrefresh == 120) ? 0x00 : 0x08, 0x00);
 	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_f0);
-
 	shoreline_update_te(ctx, vrefresh);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 
 	dev_dbg(ctx->dev, "frequency changed to %uhz\n", vrefresh);
 }
@@ -507,13 +587,13 @@ static void shoreline_pre_update_ffc(struct exynos_panel *ctx)
 
 	DPU_ATRACE_BEGIN(__func__);
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_fc);
+	SHORELINE_TEST_KEY_ON(ctx, f0);
+	SHORELINE_TEST_KEY_ON(ctx, fc);
 	/* FFC off */
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x36, 0xC5);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xC5, 0x10);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_off_fc);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_f0);
+	SHORELINE_TEST_KEY_OFF(ctx, fc);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 
 	DPU_ATRACE_END(__func__);
 }
@@ -525,6 +605,8 @@ static void shoreline_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 
 	DPU_ATRACE_BEGIN(__func__);
 
+	SHORELINE_TEST_KEY_ON(ctx, f0);
+	SHORELINE_TEST_KEY_ON(ctx, fc);
 	if (hs_clk != MIPI_DSI_FREQ_DEFAULT && hs_clk != MIPI_DSI_FREQ_ALTERNATIVE) {
 		dev_warn(ctx->dev, "%s: invalid hs_clk=%d for FFC\n", __func__, hs_clk);
 	} else if (ctx->dsi_hs_clk != hs_clk) {
@@ -532,8 +614,6 @@ static void shoreline_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 		ctx->dsi_hs_clk = hs_clk;
 
 		/* Update FFC */
-		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
-		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_fc);
 		/* 120HS */
 		EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x3E, 0xC5);
 		if (hs_clk == MIPI_DSI_FREQ_DEFAULT)
@@ -546,17 +626,13 @@ static void shoreline_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 			EXYNOS_DCS_BUF_ADD(ctx, 0xC5, 0x98, 0x62);
 		else /* MIPI_DSI_FREQ_ALTERNATIVE */
 			EXYNOS_DCS_BUF_ADD(ctx, 0xC5, 0x94, 0x74);
-		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_off_fc);
-		EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_off_f0);
 	}
 
 	/* FFC on */
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_fc);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x36, 0xC5);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xC5, 0x11, 0x10, 0x50, 0x05);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_off_fc);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_f0);
+	SHORELINE_TEST_KEY_OFF(ctx, fc);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 
 	DPU_ATRACE_END(__func__);
 }
@@ -602,11 +678,11 @@ static void shoreline_set_nolp_mode(struct exynos_panel *ctx,
 	if (!ctx->enabled)
 		return;
 
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_on_f0);
+	SHORELINE_TEST_KEY_ON(ctx, f0);
 	/* backlight control and dimming */
 	shoreline_update_wrctrld(ctx);
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_off_f0);
 	shoreline_change_frequency(ctx, vrefresh);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 	shoreline_wait_for_vsync_done(ctx);
 
 	dev_info(ctx->dev, "exit LP mode\n");
@@ -703,7 +779,7 @@ static void shoreline_set_hbm_mode(struct exynos_panel *ctx,
 
 	ctx->hbm_mode = mode;
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
+	SHORELINE_TEST_KEY_ON(ctx, f0);
 
 	if (hbm_update) {
 		/* CYC Set */
@@ -732,7 +808,7 @@ static void shoreline_set_hbm_mode(struct exynos_panel *ctx,
 			EXYNOS_DCS_BUF_ADD_SET(ctx, irc_mode[IS_HBM_ON_IRC_OFF(mode)]);
 		}
 	}
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_f0);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 	shoreline_update_wrctrld(ctx);
 
 	dev_info(ctx->dev, "hbm_on=%d hbm_ircoff=%d\n", IS_HBM_ON(ctx->hbm_mode),
@@ -810,10 +886,10 @@ static void shoreline_set_local_hbm_brightness(struct exynos_panel *ctx, bool is
 	dev_dbg(ctx->dev, "set %s brightness: [%d] %*ph\n",
 		ctl->overdrived ? "overdrive" : "normal",
 		ctl->overdrived ? group : -1, LHBM_BRT_LEN, brt);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, test_key_on_f0);
+	SHORELINE_TEST_KEY_ON(ctx, f0);
 	EXYNOS_DCS_BUF_ADD_SET(ctx, lhbm_brightness_index);
 	EXYNOS_DCS_BUF_ADD_SET(ctx, cmd);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, test_key_off_f0);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 }
 
 static void shoreline_set_local_hbm_mode_post(struct exynos_panel *ctx)
@@ -860,9 +936,9 @@ static void shoreline_calc_lhbm_od_brightness(u8 n_fine, u8 n_coarse,
 	}
 }
 
-static void shoreline_lhbm_brightness_init(struct exynos_panel *ctx)
+/* @cached: normal brightness is filled in from calibration cache already */
+static void shoreline_lhbm_brightness_init(struct exynos_panel *ctx, bool cached)
 {
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
 	struct shoreline_panel *spanel = to_spanel(ctx);
 	struct shoreline_lhbm_ctl *ctl = &spanel->lhbm_ctl;
 	int ret;
@@ -870,14 +946,19 @@ static void shoreline_lhbm_brightness_init(struct exynos_panel *ctx)
 	u8 *p_norm = ctl->brt_normal;
 	u8 *p_over;
 	enum shoreline_lhbm_brt_overdrive_group grp;
-
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_on_f0);
-	EXYNOS_DCS_WRITE_TABLE(ctx, lhbm_brightness_index);
-	ret = mipi_dsi_dcs_read(dsi, lhbm_brightness_reg, p_norm, LHBM_BRT_LEN);
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_off_f0);
-	if (ret != LHBM_BRT_LEN) {
-		dev_err(ctx->dev, "failed to read lhbm para ret=%d\n", ret);
-		return;
+	struct panel_read read = PANEL_READ(lhbm_brightness_offset, lhbm_brightness_reg,
+					    p_norm, LHBM_BRT_LEN);
+
+	if (!cached) {
+		/* commands queued in the session are flushed by the global para */
+		SHORELINE_TEST_KEY_ON(ctx, f0);
+		ret = panel_read_batch(ctx, &read, 1);
+		SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
+		if (ret) {
+			dev_err(ctx->dev, "failed to read lhbm para ret=%d\n", ret);
+			return;
+		}
+		shoreline_calib_store(ctx);
 	}
 	dev_info(ctx->dev, "lhbm normal brightness: %*ph\n", LHBM_BRT_LEN, p_norm);
 
@@ -945,21 +1026,26 @@ static void shoreline_lhbm_brightness_init(struct exynos_panel *ctx)
 static void shoreline_panel_init(struct exynos_panel *ctx)
 {
 	struct dentry *csroot = ctx->debugfs_cmdset_entry;
+	const bool cached = shoreline_calib_load(ctx);
 
 	exynos_panel_debugfs_create_cmdset(ctx, csroot,
 					   &shoreline_init_cmd_set, "init");
-	shoreline_lhbm_gamma_read(ctx);
-	shoreline_lhbm_gamma_write(ctx);
 
-	shoreline_vreg_read(ctx);
+	/*
+	 * One test key session for the whole readout. LHBM brightness is read after the
+	 * gamma write since it reads back the same register.
+	 */
+	SHORELINE_TEST_KEY_ON(ctx, f0);
+	if (!cached)
+		shoreline_otp_read(ctx);
+	shoreline_lhbm_gamma_write(ctx);
 
 	/* LHBM overdrive init */
-	shoreline_lhbm_brightness_init(ctx);
+	shoreline_lhbm_brightness_init(ctx, cached);
 	/* LHBM Location */
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_on_f0);
-	EXYNOS_DCS_WRITE_SEQ(ctx, 0xB0, 0x00, 0x09, 0x6D);
-	EXYNOS_DCS_WRITE_SEQ(ctx, 0x6D, 0xC6, 0xE3, 0x65);
-	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_off_f0);
+	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x09, 0x6D);
+	EXYNOS_DCS_BUF_ADD(ctx, 0x6D, 0xC6, 0xE3, 0x65);
+	SHORELINE_TEST_KEY_OFF_AND_FLUSH(ctx, f0);
 }
 
 static int shoreline_read_id(struct exynos_panel *ctx)
@@ -0,0 +1,118 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Nestable sessions of panel test keys and page selects.
+ *
+ * Copyright (c) 2022 Google LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Helpers open a scope before writing protected registers and close it after. Scopes
+ * nest, and only the outermost one sends the key and closes it, so helpers called from
+ * a bigger update don't toggle the key in between. Commands are not sent from here, the
+ * callers send them with their own write helpers when told to.
+ *
+ * While a session is open, the key must not be toggled by anything else, e.g. command
+ * sets with their own key commands, or the cached state goes wrong.
+ */
+
+#ifndef PANEL_KEY_H
+#define PANEL_KEY_H
+
+#include <linux/bug.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+#define PANEL_KEY_CMD_MAX	6
+
+/**
+ * struct panel_key - session of a panel key or page select
+ * @depth: number of open scopes
+ * @len: length of @cmd, 0 if nothing is sent in this session yet
+ * @cmd: the last key or page select command sent in this session
+ */
+struct panel_key {
+	u32 depth;
+	u8 len;
+	u8 cmd[PANEL_KEY_CMD_MAX];
+};
+
+/**
+ * panel_key_select - check whether @cmd has to be sent
+ * @key: key session
+ * @cmd: key or page select command
+ * @len: length of @cmd
+ *
+ * Return: false if @cmd is the last one sent in the open session, true otherwise. It's
+ *	   always true without an open session, since the panel state isn't tracked then.
+ */
+static inline bool panel_key_select(struct panel_key *key, const u8 *cmd, size_t len)
+{
+	if (!key->depth)
+		return true;
+
+	if (key->len == len && !memcmp(key->cmd, cmd, len))
+		return false;
+
+	if (WARN_ON_ONCE(len > PANEL_KEY_CMD_MAX)) {
+		key->len = 0;
+		return true;
+	}
+
+	memcpy(key->cmd, cmd, len);
+	key->len = len;
+
+	return true;
+}
+
+/**
+ * panel_key_begin - open a scope without sending anything
+ * @key: key session
+ *
+ * The key is sent by the first panel_key_get() in the scope, if any.
+ */
+static inline void panel_key_begin(struct panel_key *key)
+{
+	key->depth++;
+}
+
+/**
+ * panel_key_get - open a scope needing @cmd
+ * @key: key session
+ * @cmd: key or page select command
+ * @len: length of @cmd
+ *
+ * Return: true if @cmd has to be sent, i.e. it's not sent in this session yet.
+ */
+static inline bool panel_key_get(struct panel_key *key, const u8 *cmd, size_t len)
+{
+	panel_key_begin(key);
+
+	return panel_key_select(key, cmd, len);
+}
+
+/**
+ * panel_key_put - close a scope
+ * @key: key session
+ *
+ * Return: true if the outermost scope is closed after the key is sent in the session,
+ *	   in which case the key has to be closed, e.g. by the lock command.
+ */
+static inline bool panel_key_put(struct panel_key *key)
+{
+	bool sent;
+
+	if (WARN_ON_ONCE(!key->depth))
+		return false;
+
+	if (--key->depth)
+		return false;
+
+	sent = key->len;
+	key->len = 0;
+
+	return sent;
+}
+
+#endif /* PANEL_KEY_H */
@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Batched register reads of panels.
+ *
+ * Copyright (c) 2022 Google LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Registers are read one after another in the key or page session set up by the caller,
+ * so a whole readout shares one unlock and lock instead of one pair per register. Every
+ * entry gets its own status, a failed read doesn't stop the following ones.
+ */
+
+#ifndef PANEL_READ_H
+#define PANEL_READ_H
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+#include "panel/panel-samsung-drv.h"
+
+#define PANEL_READ_NO_GPARA	(-1)
+
+/**
+ * struct panel_read - register to read
+ * @offset: global parameter offset to read from, or PANEL_READ_NO_GPARA
+ * @reg: register to read
+ * @len: number of bytes to read
+ * @buf: destination, at least @len bytes
+ * @ret: status after panel_read_batch(), 0 or negative error code
+ */
+struct panel_read {
+	int offset;
+	u8 reg;
+	u8 len;
+	u8 *buf;
+	int ret;
+};
+
+#define PANEL_READ(_offset, _reg, _buf, _len)	\
+	{ .offset = _offset, .reg = _reg, .buf = _buf, .len = _len }
+
+/**
+ * panel_read_batch - read registers in one session
+ * @ctx: panel struct
+ * @reads: registers to read
+ * @n: number of @reads
+ *
+ * Key or page setup is up to the caller. Global parameters are sent right away, which
+ * also flushes commands queued before. An entry without one is read as is, so queued
+ * setup has to be flushed by the caller in that case.
+ *
+ * Return: 0 if all registers are read, otherwise the error of the first failed one.
+ */
+static inline int panel_read_batch(struct exynos_panel *ctx, struct panel_read *reads,
+				   size_t n)
+{
+	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
+	int err = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		struct panel_read *r = &reads[i];
+		ssize_t ret = 0;
+
+		if (r->offset != PANEL_READ_NO_GPARA) {
+			const u8 gpara[] = { 0xB0, (r->offset >> 8) & 0xFF, r->offset & 0xFF,
+					     r->reg };
+
+			ret = exynos_dsi_dcs_write_buffer(dsi, gpara, sizeof(gpara), 0);
+		}
+		if (ret >= 0)
+			ret = mipi_dsi_dcs_read(dsi, r->reg, r->buf, r->len);
+
+		if (ret == r->len)
+			r->ret = 0;
+		else
+			r->ret = ret < 0 ? ret : -EIO;
+
+		if (r->ret) {
+			dev_dbg(ctx->dev, "failed to read %#x (%d)\n", r->reg, r->ret);
+			if (!err)
+				err = r->ret;
+		}
+	}
+
+	return err;
+}
+
+#endif /* PANEL_READ_H */